@@ -0,0 +1,31 @@
+#   Copyright 2017 James Fong
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+
+# Populates:
+# - LZ4_FOUND
+# - LZ4_INCLUDE_DIRS
+# - LZ4_LIBRARIES
+
+set(LZ4_FOUND FALSE)
+find_path(LZ4_INCLUDE_DIRS NAMES "lz4.h")
+find_library(LZ4_LIBRARIES NAMES "lz4")
+
+if(LZ4_INCLUDE_DIRS AND LZ4_LIBRARIES)
+    set(LZ4_FOUND TRUE)
+endif()
+
+mark_as_advanced(
+    LZ4_INCLUDE_DIRS
+    LZ4_LIBRARIES
+)
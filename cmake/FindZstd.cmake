@@ -0,0 +1,31 @@
+#   Copyright 2017 James Fong
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+
+# Populates:
+# - ZSTD_FOUND
+# - ZSTD_INCLUDE_DIRS
+# - ZSTD_LIBRARIES
+
+set(ZSTD_FOUND FALSE)
+find_path(ZSTD_INCLUDE_DIRS NAMES "zstd.h")
+find_library(ZSTD_LIBRARIES NAMES "zstd")
+
+if(ZSTD_INCLUDE_DIRS AND ZSTD_LIBRARIES)
+    set(ZSTD_FOUND TRUE)
+endif()
+
+mark_as_advanced(
+    ZSTD_INCLUDE_DIRS
+    ZSTD_LIBRARIES
+)
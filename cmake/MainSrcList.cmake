@@ -27,6 +27,7 @@ foreach(fname
 "../thirdparty/murmurhash3/MurmurHash3.cpp"
 "Main.cpp"
 "logger/Logger.cpp"
+"main/Compress.cpp"
 "main/ConvertFont.cpp"
 "main/ConvertGenericJson.cpp"
 "main/ConvertGeometry.cpp"
@@ -35,9 +36,19 @@ foreach(fname
 "main/ConvertMiscellaneous.cpp"
 "main/ConvertWaveform.cpp"
 "main/Convert_bgfx_Shader.cpp"
+"main/Delta.cpp"
 "main/Expand_bgfx_Shader.cpp"
+"main/Hash.cpp"
+"main/IdHeader.cpp"
+"main/Index.cpp"
 "main/JsonUtil.cpp"
+"main/Pack.cpp"
+"main/Patch.cpp"
+"main/Publish.cpp"
+"main/Scheduler.cpp"
 "main/StreamWrite.cpp"
+"main/Trace.cpp"
+"main/Watcher.cpp"
 
 )
 list(APPEND PGLOCAL_SOURCES_LIST 
@@ -0,0 +1,77 @@
+#include "BlobResource.hpp"
+
+#include <iostream>
+
+#include "Decompress.hpp"
+
+BlobResource::BlobResource()
+: mFiles(0)
+, mBytes(0) {
+}
+
+BlobResource::~BlobResource() {
+}
+
+void BlobResource::setMappedFiles(MappedFileCache* files) {
+    mFiles = files;
+}
+
+bool BlobResource::load() {
+    if(mBytes) {
+        return true;
+    }
+    
+    if(!isCodecAvailable(this->getCodec())) {
+        std::cout << "Codec not available: " << this->getName() << std::endl;
+        return false;
+    }
+    
+    if(mFiles) {
+        mMapping = mFiles->open(this->getFile());
+    } else {
+        mMapping = std::make_shared<MappedFile>();
+        if(!mMapping->open(this->getFile())) {
+            mMapping.reset();
+        }
+    }
+    if(!mMapping || this->getOffset() + this->getSize() > mMapping->getSize()) {
+        mMapping.reset();
+        return false;
+    }
+    
+    // The checksum is not compared here since that would read every page.
+    // Use ResourceManager::startVerifying() instead.
+    const uint8_t* stored = mMapping->getData() + this->getOffset();
+    if(this->getCodec() == 0) {
+        mBytes = stored;
+        return true;
+    }
+    
+    // Compressed bytes cannot be used in place, so they are decompressed into
+    // memory of its own and the mapping is let go
+    mOwned.resize(this->getRawSize());
+    bool decompressed = decompress(this->getCodec(), stored, this->getSize(), mOwned.data(), mOwned.size());
+    mMapping.reset();
+    if(!decompressed) {
+        std::cout << "Corrupt compressed data: " << this->getName() << std::endl;
+        std::vector<uint8_t>().swap(mOwned);
+        return false;
+    }
+    mBytes = mOwned.data();
+    return true;
+}
+
+bool BlobResource::unload() {
+    mBytes = 0;
+    mMapping.reset();
+    std::vector<uint8_t>().swap(mOwned);
+    return true;
+}
+
+uint64_t BlobResource::getMemoryUsage() {
+    return mOwned.capacity();
+}
+
+const uint8_t* BlobResource::getBytes() {
+    return mBytes;
+}
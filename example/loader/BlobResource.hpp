@@ -0,0 +1,38 @@
+#ifndef BLOBRESOURCE_HPP
+#define BLOBRESOURCE_HPP
+
+#include <memory>
+#include <vector>
+
+#include "Resource.hpp"
+#include "MappedFile.hpp"
+
+// Raw bytes of a resource, viewed straight from the mapped file instead of
+// being read into memory. Loading only maps the file; pages are read from
+// disk the first time they are touched. Those pages belong to the OS page
+// cache, so blobs count as no memory against the manager's budget.
+// Compressed blobs are the exception: they are decompressed into memory of
+// their own when loaded.
+class BlobResource : public Resource {
+private:
+    MappedFileCache* mFiles;
+    std::shared_ptr<MappedFile> mMapping;
+    const uint8_t* mBytes;
+    std::vector<uint8_t> mOwned;
+public:
+    BlobResource();
+    virtual ~BlobResource();
+    
+    // Shares mappings with other resources in the same file. Without it,
+    // every blob maps its file on its own.
+    void setMappedFiles(MappedFileCache* files);
+    
+    bool load();
+    bool unload();
+    uint64_t getMemoryUsage();
+    
+    // Exactly getRawSize() bytes, only valid while grabbed
+    const uint8_t* getBytes();
+};
+
+#endif // BLOBRESOURCE_HPP
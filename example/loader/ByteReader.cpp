@@ -0,0 +1,83 @@
+#include "ByteReader.hpp"
+
+#include <cstring>
+
+ByteReader::ByteReader(const uint8_t* data, std::size_t size)
+: mData(data)
+, mSize(size)
+, mPos(0)
+, mFailed(false) {
+}
+
+const uint8_t* ByteReader::take(std::size_t size) {
+    if(mFailed || size > mSize - mPos) {
+        mFailed = true;
+        return 0;
+    }
+    const uint8_t* data = mData + mPos;
+    mPos += size;
+    return data;
+}
+
+uint8_t ByteReader::readU8() {
+    const uint8_t* data = take(1);
+    return data ? data[0] : 0;
+}
+
+uint16_t ByteReader::readU16() {
+    const uint8_t* data = take(2);
+    if(!data) {
+        return 0;
+    }
+    return (uint16_t) (data[0] | data[1] << 8);
+}
+
+uint32_t ByteReader::readU32() {
+    const uint8_t* data = take(4);
+    if(!data) {
+        return 0;
+    }
+    return (uint32_t) data[0] 
+        | (uint32_t) data[1] << 8 
+        | (uint32_t) data[2] << 16 
+        | (uint32_t) data[3] << 24;
+}
+
+uint64_t ByteReader::readU64() {
+    uint64_t low = readU32();
+    uint64_t high = readU32();
+    return low | high << 32;
+}
+
+float ByteReader::readF32() {
+    // resman stores the IEEE 754 bits
+    uint32_t bits = readU32();
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+bool ByteReader::readBool() {
+    return readU8() != 0;
+}
+
+std::string ByteReader::readString() {
+    uint32_t size = readU32();
+    const uint8_t* data = take(size);
+    if(!data) {
+        return std::string();
+    }
+    return std::string(reinterpret_cast<const char*>(data), size);
+}
+
+const uint8_t* ByteReader::skip(std::size_t size) {
+    return take(size);
+}
+
+bool ByteReader::hasFailed() const {
+    return mFailed;
+}
+
+std::size_t ByteReader::getPosition() const {
+    return mPos;
+}
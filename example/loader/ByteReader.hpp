@@ -0,0 +1,37 @@
+#ifndef BYTEREADER_HPP
+#define BYTEREADER_HPP
+
+#include <stdint.h>
+#include <string>
+
+// Reads the little-endian values written by resman's StreamWrite from
+// memory. Reading past the end gives zeroes and marks the reader as failed,
+// so a parser only needs to check once when it is done.
+class ByteReader {
+private:
+    const uint8_t* mData;
+    std::size_t mSize;
+    std::size_t mPos;
+    bool mFailed;
+    
+    const uint8_t* take(std::size_t size);
+public:
+    ByteReader(const uint8_t* data, std::size_t size);
+    
+    uint8_t readU8();
+    uint16_t readU16();
+    uint32_t readU32();
+    uint64_t readU64();
+    float readF32();
+    bool readBool();
+    std::string readString();
+    
+    // Steps over bytes that are used in place. Returns where they start, or
+    // 0 if there are not that many left.
+    const uint8_t* skip(std::size_t size);
+    
+    bool hasFailed() const;
+    std::size_t getPosition() const;
+};
+
+#endif // BYTEREADER_HPP
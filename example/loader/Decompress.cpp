@@ -0,0 +1,64 @@
+#include "Decompress.hpp"
+
+#include <cstring>
+
+#ifdef LOADER_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+#ifdef LOADER_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+uint32_t parseCodec(const std::string& name) {
+    if(name == "none") {
+        return CODEC_NONE;
+    } else if(name == "lz4") {
+        return CODEC_LZ4;
+    } else if(name == "zstd") {
+        return CODEC_ZSTD;
+    }
+    return CODEC_UNKNOWN;
+}
+
+bool isCodecAvailable(uint32_t codec) {
+    switch(codec) {
+        case CODEC_NONE: return true;
+#ifdef LOADER_HAVE_LZ4
+        case CODEC_LZ4: return true;
+#endif
+#ifdef LOADER_HAVE_ZSTD
+        case CODEC_ZSTD: return true;
+#endif
+        default: return false;
+    }
+}
+
+bool decompress(uint32_t codec, const uint8_t* data, std::size_t size, 
+        uint8_t* rawData, std::size_t rawSize) {
+    switch(codec) {
+        case CODEC_NONE: {
+            if(size != rawSize) {
+                return false;
+            }
+            std::memcpy(rawData, data, size);
+            return true;
+        }
+#ifdef LOADER_HAVE_LZ4
+        case CODEC_LZ4: {
+            int result = LZ4_decompress_safe(reinterpret_cast<const char*>(data), 
+                reinterpret_cast<char*>(rawData), size, rawSize);
+            return result >= 0 && (std::size_t) result == rawSize;
+        }
+#endif
+#ifdef LOADER_HAVE_ZSTD
+        case CODEC_ZSTD: {
+            std::size_t result = ZSTD_decompress(rawData, rawSize, data, size);
+            return !ZSTD_isError(result) && result == rawSize;
+        }
+#endif
+        default: {
+            return false;
+        }
+    }
+}
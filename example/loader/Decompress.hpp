@@ -0,0 +1,29 @@
+#ifndef DECOMPRESS_HPP
+#define DECOMPRESS_HPP
+
+#include <stdint.h>
+#include <string>
+
+// Must match resman's Codec, the values are stored in data.index. Each codec
+// is only available if the loader is built with LOADER_HAVE_LZ4 or
+// LOADER_HAVE_ZSTD.
+enum Codec {
+    CODEC_NONE = 0,
+    CODEC_LZ4 = 1,
+    CODEC_ZSTD = 2,
+    
+    // Named in data.package, but not known to this loader
+    CODEC_UNKNOWN = 0xffffffff
+};
+
+// Codec from its name in data.package, CODEC_UNKNOWN if there is none
+uint32_t parseCodec(const std::string& name);
+
+bool isCodecAvailable(uint32_t codec);
+
+// Returns false if the codec is not available or the data is corrupt.
+// rawSize must be the exact size of the original data.
+bool decompress(uint32_t codec, const uint8_t* data, std::size_t size, 
+    uint8_t* rawData, std::size_t rawSize);
+
+#endif // DECOMPRESS_HPP
@@ -0,0 +1,48 @@
+#include "FontResource.hpp"
+
+#include "ByteReader.hpp"
+
+FontResource::FontResource() {
+    this->clear();
+}
+
+FontResource::~FontResource() {
+}
+
+bool FontResource::parse(const uint8_t* data, std::size_t size) {
+    ByteReader reader(data, size);
+    mTexture = reader.readString();
+    mBaseline = reader.readF32();
+    mPadding = reader.readF32();
+    for(uint32_t i = 0; i < 256; ++ i) {
+        mGlyphWidth[i] = reader.readF32();
+        mGlyphStartX[i] = reader.readF32();
+    }
+    return !reader.hasFailed();
+}
+
+void FontResource::clear() {
+    std::string().swap(mTexture);
+    mBaseline = 0.f;
+    mPadding = 0.f;
+    for(uint32_t i = 0; i < 256; ++ i) {
+        mGlyphWidth[i] = 0.f;
+        mGlyphStartX[i] = 0.f;
+    }
+}
+
+const std::string& FontResource::getTexture() {
+    return mTexture;
+}
+float FontResource::getBaseline() {
+    return mBaseline;
+}
+float FontResource::getPadding() {
+    return mPadding;
+}
+float FontResource::getGlyphWidth(uint8_t code) {
+    return mGlyphWidth[code];
+}
+float FontResource::getGlyphStartX(uint8_t code) {
+    return mGlyphStartX[code];
+}
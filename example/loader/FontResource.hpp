@@ -0,0 +1,30 @@
+#ifndef FONTRESOURCE_HPP
+#define FONTRESOURCE_HPP
+
+#include "ParsedResource.hpp"
+
+// Glyph metrics made by resman's convertFont. Widths and offsets are
+// fractions of a glyph cell, indexed by character code.
+class FontResource : public ParsedResource {
+private:
+    std::string mTexture;
+    float mBaseline;
+    float mPadding;
+    float mGlyphWidth[256];
+    float mGlyphStartX[256];
+protected:
+    bool parse(const uint8_t* data, std::size_t size);
+    void clear();
+public:
+    FontResource();
+    virtual ~FontResource();
+    
+    // Name of the texture holding the glyphs
+    const std::string& getTexture();
+    float getBaseline();
+    float getPadding();
+    float getGlyphWidth(uint8_t code);
+    float getGlyphStartX(uint8_t code);
+};
+
+#endif // FONTRESOURCE_HPP
@@ -0,0 +1,45 @@
+#include "FormatVersion.hpp"
+
+#include <sstream>
+
+FormatVersion::FormatVersion()
+: mMajor(0)
+, mMinor(0)
+, mPatch(0) {
+}
+
+FormatVersion::FormatVersion(uint32_t majorVersion, uint32_t minorVersion, uint32_t patchVersion)
+: mMajor(majorVersion)
+, mMinor(minorVersion)
+, mPatch(patchVersion) {
+}
+
+FormatVersion FormatVersion::unpack(uint32_t packed) {
+    return FormatVersion(packed >> 16, (packed >> 8) & 0xff, packed & 0xff);
+}
+
+FormatVersion FormatVersion::newest() {
+    // Must match resman's n_fversion_*
+    return FormatVersion(0, 3, 0);
+}
+
+bool FormatVersion::isKnown() const {
+    return mMajor != 0 || mMinor != 0 || mPatch != 0;
+}
+
+bool FormatVersion::isSupported() const {
+    FormatVersion supported = newest();
+    if(!isKnown() || mMajor != supported.mMajor) {
+        return false;
+    }
+    if(mMajor == 0) {
+        return mMinor == supported.mMinor;
+    }
+    return mMinor <= supported.mMinor;
+}
+
+std::string FormatVersion::toString() const {
+    std::stringstream sss;
+    sss << mMajor << "." << mMinor << "." << mPatch;
+    return sss.str();
+}
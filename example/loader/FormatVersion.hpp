@@ -0,0 +1,35 @@
+#ifndef FORMATVERSION_HPP
+#define FORMATVERSION_HPP
+
+#include <stdint.h>
+#include <string>
+
+// Version of the formats written by resman's converters. Stored as
+// "fversion" in data.package and packed into data.index.
+class FormatVersion {
+private:
+    uint32_t mMajor;
+    uint32_t mMinor;
+    uint32_t mPatch;
+public:
+    // Unknown, which is never supported
+    FormatVersion();
+    FormatVersion(uint32_t majorVersion, uint32_t minorVersion, uint32_t patchVersion);
+    
+    // As stored in data.index, major << 16 | minor << 8 | patch
+    static FormatVersion unpack(uint32_t packed);
+    
+    // The version the typed resources were written against
+    static FormatVersion newest();
+    
+    bool isKnown() const;
+    
+    // Older minor versions of the same major version can still be read.
+    // While the major version is zero every minor version may break the
+    // formats, so it has to match. Patch versions never change them.
+    bool isSupported() const;
+    
+    std::string toString() const;
+};
+
+#endif // FORMATVERSION_HPP
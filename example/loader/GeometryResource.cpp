@@ -0,0 +1,184 @@
+#include "GeometryResource.hpp"
+
+#include "ByteReader.hpp"
+
+namespace {
+
+// Bytes taken by each attribute, in the order of the flags
+const uint32_t attributeSizes[] = {12, 16, 8, 12, 12, 12, 20};
+const uint32_t numAttributes = 7;
+
+// Sections present, the first byte of the file
+const uint8_t hasVertices = 1 << 0;
+const uint8_t hasTriangles = 1 << 1;
+const uint8_t hasBones = 1 << 2;
+const uint8_t hasLightprobes = 1 << 3;
+
+// Bytes taken by the attributes among the first few flags
+uint32_t attributesSize(uint8_t attributes, uint32_t numFlags) {
+    uint32_t size = 0;
+    for(uint32_t i = 0; i < numFlags; ++ i) {
+        if(attributes & (1 << i)) {
+            size += attributeSizes[i];
+        }
+    }
+    return size;
+}
+
+void readBoneWeights(ByteReader& reader, uint8_t* ids, float* weights) {
+    for(uint32_t i = 0; i < 4; ++ i) {
+        ids[i] = reader.readU8();
+    }
+    for(uint32_t i = 0; i < 4; ++ i) {
+        weights[i] = reader.readF32();
+    }
+}
+
+}
+
+GeometryResource::GeometryResource() {
+    this->clear();
+}
+
+GeometryResource::~GeometryResource() {
+}
+
+bool GeometryResource::parse(const uint8_t* data, std::size_t size) {
+    ByteReader reader(data, size);
+    uint8_t sections = reader.readU8();
+    
+    if(sections & hasVertices) {
+        mAttributes = reader.readU8();
+        mVertexSkinning = reader.readU8();
+        mNumVertices = reader.readU32();
+        mVertexSize = attributesSize(mAttributes, numAttributes);
+        mVertices = reader.skip((std::size_t) mNumVertices * mVertexSize);
+    }
+    
+    if(sections & hasTriangles) {
+        mNumTriangles = reader.readU32();
+        
+        // Same choice as resman makes when writing
+        if(mNumVertices <= 1 << 8) {
+            mIndexSize = 1;
+        } else if(mNumVertices <= 1 << 16) {
+            mIndexSize = 2;
+        } else {
+            mIndexSize = 4;
+        }
+        mIndices = reader.skip((std::size_t) mNumTriangles * 3 * mIndexSize);
+    }
+    
+    if(sections & hasBones) {
+        uint32_t numBones = reader.readU8() + 1;
+        mBones.resize(numBones);
+        for(uint32_t i = 0; i < numBones; ++ i) {
+            Bone& bone = mBones[i];
+            bone.name = reader.readString();
+            bone.hasParent = reader.readBool();
+            bone.parent = bone.hasParent ? reader.readU8() : 0;
+            bone.children.resize(reader.readU8());
+            for(std::size_t j = 0; j < bone.children.size(); ++ j) {
+                bone.children[j] = reader.readU8();
+            }
+        }
+    }
+    
+    if(sections & hasLightprobes) {
+        mLightprobeSkinning = reader.readU8();
+        uint32_t numLightprobes = reader.readU8() + 1;
+        mLightprobes.resize(numLightprobes);
+        for(uint32_t i = 0; i < numLightprobes; ++ i) {
+            Lightprobe& probe = mLightprobes[i];
+            probe.x = reader.readF32();
+            probe.y = reader.readF32();
+            probe.z = reader.readF32();
+            probe.useBoneWeights = reader.readBool();
+            if(probe.useBoneWeights) {
+                readBoneWeights(reader, probe.boneIds, probe.boneWeights);
+            } else {
+                for(uint32_t j = 0; j < 4; ++ j) {
+                    probe.boneIds[j] = 0;
+                    probe.boneWeights[j] = 0.f;
+                }
+            }
+        }
+    }
+    
+    return !reader.hasFailed();
+}
+
+void GeometryResource::clear() {
+    mAttributes = 0;
+    mVertexSkinning = LINEAR_BLEND;
+    mNumVertices = 0;
+    mVertexSize = 0;
+    mVertices = 0;
+    mNumTriangles = 0;
+    mIndexSize = 0;
+    mIndices = 0;
+    std::vector<Bone>().swap(mBones);
+    mLightprobeSkinning = LINEAR_BLEND;
+    std::vector<Lightprobe>().swap(mLightprobes);
+}
+
+uint64_t GeometryResource::getMemoryUsage() {
+    // Vertices and indices stay in the blob
+    return BlobResource::getMemoryUsage() 
+        + mBones.capacity() * sizeof(Bone) 
+        + mLightprobes.capacity() * sizeof(Lightprobe);
+}
+
+uint8_t GeometryResource::getAttributes() {
+    return mAttributes;
+}
+
+uint32_t GeometryResource::getAttributeOffset(Attribute attribute) {
+    uint32_t flag = 0;
+    while(flag < numAttributes && (1 << flag) != attribute) {
+        ++ flag;
+    }
+    return attributesSize(mAttributes, flag);
+}
+
+uint8_t GeometryResource::getVertexSkinning() {
+    return mVertexSkinning;
+}
+uint32_t GeometryResource::getNumVertices() {
+    return mNumVertices;
+}
+uint32_t GeometryResource::getVertexSize() {
+    return mVertexSize;
+}
+const uint8_t* GeometryResource::getVertices() {
+    return mVertices;
+}
+
+uint32_t GeometryResource::getNumTriangles() {
+    return mNumTriangles;
+}
+uint32_t GeometryResource::getIndexSize() {
+    return mIndexSize;
+}
+const uint8_t* GeometryResource::getIndices() {
+    return mIndices;
+}
+
+uint32_t GeometryResource::getIndex(uint32_t corner) {
+    const uint8_t* data = mIndices + (std::size_t) corner * mIndexSize;
+    uint32_t index = 0;
+    for(uint32_t i = 0; i < mIndexSize; ++ i) {
+        index |= (uint32_t) data[i] << (i * 8);
+    }
+    return index;
+}
+
+const std::vector<GeometryResource::Bone>& GeometryResource::getBones() {
+    return mBones;
+}
+uint8_t GeometryResource::getLightprobeSkinning() {
+    return mLightprobeSkinning;
+}
+const std::vector<GeometryResource::Lightprobe>& GeometryResource::getLightprobes() {
+    return mLightprobes;
+}
@@ -0,0 +1,94 @@
+#ifndef GEOMETRYRESOURCE_HPP
+#define GEOMETRYRESOURCE_HPP
+
+#include <vector>
+
+#include "ParsedResource.hpp"
+
+// A mesh made by resman's outputMesh. Vertices and triangles are used in
+// place: every vertex has the same size and the attributes it has are
+// stored in the order of the flags below, as little-endian IEEE floats.
+// On little-endian machines they can be handed to the graphics API as
+// they are. They are not aligned, so use getIndex() or copy them before
+// reading on the CPU.
+class GeometryResource : public ParsedResource {
+public:
+    enum Attribute {
+        LOCATION = 1 << 0,      // 3 floats
+        COLOR = 1 << 1,         // 4 floats
+        UV = 1 << 2,            // 2 floats
+        NORMAL = 1 << 3,        // 3 floats
+        TANGENT = 1 << 4,       // 3 floats
+        BITANGENT = 1 << 5,     // 3 floats
+        BONE_WEIGHTS = 1 << 6   // 4 u8 bone ids, then 4 float weights
+    };
+    
+    enum Skinning {
+        LINEAR_BLEND = 0,
+        DUAL_QUAT = 1,
+        IMPLICIT = 2
+    };
+    
+    struct Bone {
+        std::string name;
+        bool hasParent;
+        uint8_t parent;
+        std::vector<uint8_t> children;
+    };
+    
+    struct Lightprobe {
+        float x;
+        float y;
+        float z;
+        bool useBoneWeights;
+        uint8_t boneIds[4];
+        float boneWeights[4];
+    };
+private:
+    uint8_t mAttributes;
+    uint8_t mVertexSkinning;
+    uint32_t mNumVertices;
+    uint32_t mVertexSize;
+    const uint8_t* mVertices;
+    
+    uint32_t mNumTriangles;
+    uint32_t mIndexSize;
+    const uint8_t* mIndices;
+    
+    std::vector<Bone> mBones;
+    uint8_t mLightprobeSkinning;
+    std::vector<Lightprobe> mLightprobes;
+protected:
+    bool parse(const uint8_t* data, std::size_t size);
+    void clear();
+public:
+    GeometryResource();
+    virtual ~GeometryResource();
+    
+    uint64_t getMemoryUsage();
+    
+    // Combination of Attribute flags
+    uint8_t getAttributes();
+    
+    // Where an attribute starts within a vertex, if the vertices have it
+    uint32_t getAttributeOffset(Attribute attribute);
+    
+    uint8_t getVertexSkinning();
+    uint32_t getNumVertices();
+    uint32_t getVertexSize();
+    const uint8_t* getVertices();
+    
+    // Indices take 1, 2 or 4 bytes depending on the number of vertices
+    uint32_t getNumTriangles();
+    uint32_t getIndexSize();
+    const uint8_t* getIndices();
+    
+    // One of the three corners of a triangle, corner = triangle * 3 + n
+    uint32_t getIndex(uint32_t corner);
+    
+    const std::vector<Bone>& getBones();
+    uint8_t getLightprobeSkinning();
+    const std::vector<Lightprobe>& getLightprobes();
+};
+
+#endif // GEOMETRYRESOURCE_HPP
@@ -0,0 +1,59 @@
+#include "ImageResource.hpp"
+
+// resman only ever writes PNGs
+#define STBI_ONLY_PNG
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+ImageResource::ImageResource()
+: mPixels(0)
+, mWidth(0)
+, mHeight(0)
+, mNumComponents(0) {
+}
+
+ImageResource::~ImageResource() {
+    this->clear();
+}
+
+bool ImageResource::parse(const uint8_t* data, std::size_t size) {
+    int width;
+    int height;
+    int components;
+    mPixels = stbi_load_from_memory(data, (int) size, &width, &height, &components, 0);
+    if(!mPixels) {
+        return false;
+    }
+    mWidth = width;
+    mHeight = height;
+    mNumComponents = components;
+    return true;
+}
+
+void ImageResource::clear() {
+    if(mPixels) {
+        stbi_image_free(mPixels);
+    }
+    mPixels = 0;
+    mWidth = 0;
+    mHeight = 0;
+    mNumComponents = 0;
+}
+
+uint64_t ImageResource::getMemoryUsage() {
+    return BlobResource::getMemoryUsage() 
+        + (uint64_t) mWidth * mHeight * mNumComponents;
+}
+
+uint32_t ImageResource::getWidth() {
+    return mWidth;
+}
+uint32_t ImageResource::getHeight() {
+    return mHeight;
+}
+uint32_t ImageResource::getNumComponents() {
+    return mNumComponents;
+}
+const uint8_t* ImageResource::getPixels() {
+    return mPixels;
+}
@@ -0,0 +1,31 @@
+#ifndef IMAGERESOURCE_HPP
+#define IMAGERESOURCE_HPP
+
+#include "ParsedResource.hpp"
+
+// A PNG made by resman's convertImage, decoded straight from the mapped
+// file. The pixels are 8 bits per component, rows top to bottom.
+class ImageResource : public ParsedResource {
+private:
+    uint8_t* mPixels;
+    uint32_t mWidth;
+    uint32_t mHeight;
+    uint32_t mNumComponents;
+protected:
+    bool parse(const uint8_t* data, std::size_t size);
+    void clear();
+public:
+    ImageResource();
+    virtual ~ImageResource();
+    
+    uint64_t getMemoryUsage();
+    
+    uint32_t getWidth();
+    uint32_t getHeight();
+    
+    // 1 for grey, 2 for grey and alpha, 3 for RGB, 4 for RGBA
+    uint32_t getNumComponents();
+    const uint8_t* getPixels();
+};
+
+#endif // IMAGERESOURCE_HPP
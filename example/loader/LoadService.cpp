@@ -0,0 +1,77 @@
+#include "LoadService.hpp"
+
+bool LoadService::Request::operator<(const Request& other) const {
+    // std::priority_queue puts the largest first
+    if(priority != other.priority) {
+        return priority < other.priority;
+    }
+    return sequence > other.sequence;
+}
+
+LoadService::LoadService(uint32_t numThreads)
+: mNextSequence(0)
+, mStopping(false) {
+    if(numThreads == 0) {
+        numThreads = 1;
+    }
+    for(uint32_t i = 0; i < numThreads; ++ i) {
+        mThreads.push_back(std::thread(&LoadService::work, this));
+    }
+}
+
+LoadService::~LoadService() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mWake.notify_all();
+    for(std::size_t i = 0; i < mThreads.size(); ++ i) {
+        mThreads[i].join();
+    }
+    while(!mQueue.empty()) {
+        mQueue.top().promise->set_value(0);
+        mQueue.pop();
+    }
+}
+
+std::shared_future<Resource*> LoadService::request(Resource* res, int priority) {
+    Request request;
+    request.priority = priority;
+    request.resource = res;
+    request.promise = std::make_shared<std::promise<Resource*> >();
+    std::shared_future<Resource*> future = request.promise->get_future().share();
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        request.sequence = mNextSequence ++;
+        mQueue.push(request);
+    }
+    mWake.notify_one();
+    return future;
+}
+
+std::size_t LoadService::getNumPending() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mQueue.size();
+}
+
+void LoadService::work() {
+    while(true) {
+        Request request;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWake.wait(lock, [this]() { return mStopping || !mQueue.empty(); });
+            if(mStopping) {
+                return;
+            }
+            request = mQueue.top();
+            mQueue.pop();
+        }
+        
+        Resource* res = request.resource;
+        if(!res->grab()) {
+            res->drop();
+            res = 0;
+        }
+        request.promise->set_value(res);
+    }
+}
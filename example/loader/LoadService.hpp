@@ -0,0 +1,53 @@
+#ifndef LOADSERVICE_HPP
+#define LOADSERVICE_HPP
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "Resource.hpp"
+
+// Loads resources on a pool of I/O threads so that the caller never waits
+// on the disk. Requests with a higher priority are started first; equal
+// priorities are started in the order they were made.
+class LoadService {
+private:
+    struct Request {
+        int priority;
+        uint64_t sequence;
+        Resource* resource;
+        std::shared_ptr<std::promise<Resource*> > promise;
+        
+        bool operator<(const Request& other) const;
+    };
+    
+    std::vector<std::thread> mThreads;
+    std::priority_queue<Request> mQueue;
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    uint64_t mNextSequence;
+    bool mStopping;
+    
+    void work();
+public:
+    LoadService(uint32_t numThreads);
+    
+    // Requests that were never started resolve to 0
+    ~LoadService();
+    
+    // Grabs the resource on an I/O thread. The future resolves to the
+    // resource once it is loaded, or to 0 if loading failed. The caller owns
+    // the grab and must drop the resource when done with it.
+    std::shared_future<Resource*> request(Resource* res, int priority);
+    
+    // Number of requests not yet started
+    std::size_t getNumPending();
+};
+
+#endif // LOADSERVICE_HPP
@@ -0,0 +1,75 @@
+#include "MappedFile.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile()
+: mData(0)
+, mSize(0) {
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const boost::filesystem::path& file) {
+    close();
+    
+    int fd = ::open(file.c_str(), O_RDONLY);
+    if(fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if(::fstat(fd, &info) != 0) {
+        ::close(fd);
+        return false;
+    }
+    
+    // Zero-length mappings are not allowed
+    if(info.st_size == 0) {
+        ::close(fd);
+        return true;
+    }
+    
+    void* data = ::mmap(0, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(data == MAP_FAILED) {
+        return false;
+    }
+    mData = static_cast<const uint8_t*>(data);
+    mSize = info.st_size;
+    return true;
+}
+
+void MappedFile::close() {
+    if(mData) {
+        ::munmap(const_cast<uint8_t*>(mData), mSize);
+    }
+    mData = 0;
+    mSize = 0;
+}
+
+const uint8_t* MappedFile::getData() const {
+    return mData;
+}
+std::size_t MappedFile::getSize() const {
+    return mSize;
+}
+
+std::shared_ptr<MappedFile> MappedFileCache::open(const boost::filesystem::path& file) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::weak_ptr<MappedFile>& cached = mFiles[file];
+    std::shared_ptr<MappedFile> mapping = cached.lock();
+    if(mapping) {
+        return mapping;
+    }
+    
+    mapping = std::make_shared<MappedFile>();
+    if(!mapping->open(file)) {
+        return std::shared_ptr<MappedFile>();
+    }
+    cached = mapping;
+    return mapping;
+}
@@ -0,0 +1,42 @@
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include <boost/filesystem.hpp>
+
+// Read-only view of a whole file, mapped into memory
+class MappedFile {
+private:
+    const uint8_t* mData;
+    std::size_t mSize;
+    
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+public:
+    MappedFile();
+    ~MappedFile();
+    
+    bool open(const boost::filesystem::path& file);
+    void close();
+    
+    const uint8_t* getData() const;
+    std::size_t getSize() const;
+};
+
+// Shares one mapping of each file among everything viewing it. A file is
+// unmapped once nothing holds its mapping anymore.
+class MappedFileCache {
+private:
+    std::mutex mMutex;
+    std::map<boost::filesystem::path, std::weak_ptr<MappedFile> > mFiles;
+public:
+    // Returns 0 if the file cannot be mapped
+    std::shared_ptr<MappedFile> open(const boost::filesystem::path& file);
+};
+
+#endif // MAPPEDFILE_HPP
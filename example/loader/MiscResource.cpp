@@ -1,17 +1,7 @@
 #include "MiscResource.hpp"
 
-#include <fstream>
-
 MiscResource::MiscResource() {
 }
 
 MiscResource::~MiscResource() {
 }
-
-bool MiscResource::load() {
-    return true;
-}
-
-bool MiscResource::unload() {
-    return true;
-}
@@ -1,15 +1,13 @@
 #ifndef MiscRESOURCE_HPP
 #define MiscRESOURCE_HPP
 
-#include "Resource.hpp"
+#include "BlobResource.hpp"
 
-class MiscResource : public Resource {
+// Any resource without a loader of its own, available as raw bytes
+class MiscResource : public BlobResource {
 public:
     MiscResource();
     virtual ~MiscResource();
-    
-    bool load();
-    bool unload();
 };
 
 #endif // MiscRESOURCE_HPP
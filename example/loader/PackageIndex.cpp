@@ -0,0 +1,247 @@
+#include "PackageIndex.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "MurmurHash3.h"
+
+namespace {
+
+const char* const indexMagic = "RESMINDX";
+const uint32_t indexVersion = 2;
+const uint64_t indexHeaderSize = 80;
+const uint64_t indexRecordSize = 64;
+const uint32_t indexFlagMerkleRoot = 1;
+
+// Must match resman's n_hash_seed and n_hash_chunk_size
+const uint32_t hashSeed = 0xdaff0d11;
+const std::size_t hashChunkSize = 1 << 20;
+
+uint32_t readU32(const uint8_t* data) {
+    return (uint32_t) data[0] 
+        | (uint32_t) data[1] << 8 
+        | (uint32_t) data[2] << 16 
+        | (uint32_t) data[3] << 24;
+}
+
+uint64_t readU64(const uint8_t* data) {
+    return (uint64_t) readU32(data) | (uint64_t) readU32(data + 4) << 32;
+}
+
+// Whether count items of itemSize bytes at offset fit in size bytes,
+// without overflowing on damaged values
+bool fits(uint64_t offset, uint64_t count, uint64_t itemSize, uint64_t size) {
+    return offset <= size && count <= (size - offset) / itemSize;
+}
+
+// Must match resman's index_slot()
+uint32_t indexSlot(uint64_t hash, uint32_t displacement, uint32_t numEntries) {
+    uint64_t mixed = hash + displacement * 0x9e3779b97f4a7c15ULL;
+    mixed ^= mixed >> 33;
+    mixed *= 0xff51afd7ed558ccdULL;
+    mixed ^= mixed >> 33;
+    mixed *= 0xc4ceb9fe1a85ec53ULL;
+    mixed ^= mixed >> 33;
+    return mixed % numEntries;
+}
+
+// Must match resman's merkle_parent()
+uint64_t merkleParent(uint64_t left, uint64_t right) {
+    uint64_t pair[2] = {left, right};
+    uint64_t out[2];
+    MurmurHash3_x64_128(pair, sizeof(pair), hashSeed, out);
+    return out[0];
+}
+
+} // namespace
+
+PackageIndex::PackageIndex()
+: mNumEntries(0)
+, mNumBuckets(0)
+, mNumTypes(0)
+, mTypes(0)
+, mBuckets(0)
+, mRecords(0)
+, mStrings(0)
+, mStringsSize(0)
+, mFlags(0)
+, mResourceVersion(0)
+, mMerkleRoot(0) {
+}
+
+bool PackageIndex::open(const boost::filesystem::path& file) {
+    if(!mFile.open(file)) {
+        return false;
+    }
+    const uint8_t* data = mFile.getData();
+    std::size_t size = mFile.getSize();
+    if(size < indexHeaderSize || std::memcmp(data, indexMagic, 8) != 0 
+            || readU32(data + 8) != indexVersion) {
+        mFile.close();
+        return false;
+    }
+    mNumEntries = readU32(data + 12);
+    mNumBuckets = readU32(data + 16);
+    mNumTypes = readU32(data + 20);
+    uint64_t typesOffset = readU64(data + 24);
+    uint64_t bucketsOffset = readU64(data + 32);
+    uint64_t recordsOffset = readU64(data + 40);
+    uint64_t stringsOffset = readU64(data + 48);
+    mStringsSize = readU64(data + 56);
+    mFlags = readU32(data + 64);
+    mResourceVersion = readU32(data + 68);
+    mMerkleRoot = readU64(data + 72);
+    
+    if(mNumBuckets == 0
+            || !fits(typesOffset, mNumTypes, 8, size)
+            || !fits(bucketsOffset, mNumBuckets, 4, size)
+            || !fits(recordsOffset, mNumEntries, indexRecordSize, size)
+            || !fits(stringsOffset, mStringsSize, 1, size)) {
+        mFile.close();
+        return false;
+    }
+    mTypes = data + typesOffset;
+    mBuckets = data + bucketsOffset;
+    mRecords = data + recordsOffset;
+    mStrings = reinterpret_cast<const char*>(data + stringsOffset);
+    
+    // Records point into the string pool and the type table, so that is
+    // checked once here rather than on every lookup
+    for(uint32_t slot = 0; slot < mNumEntries; ++ slot) {
+        const uint8_t* record = mRecords + slot * indexRecordSize;
+        if(!fits(readU32(record + 8), readU32(record + 12), 1, mStringsSize)
+                || readU32(record + 16) >= mNumTypes
+                || !fits(readU32(record + 24), readU32(record + 28), 1, mStringsSize)) {
+            mFile.close();
+            return false;
+        }
+    }
+    return true;
+}
+
+uint64_t PackageIndex::hashName(const std::string& name) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for(std::size_t i = 0; i < name.size(); ++ i) {
+        hash ^= (uint8_t) name[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+uint64_t PackageIndex::checksum(const void* data, std::size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    std::vector<uint64_t> chunkHashes;
+    for(std::size_t offset = 0; offset < size; offset += hashChunkSize) {
+        std::size_t chunkSize = std::min(hashChunkSize, size - offset);
+        uint64_t out[2];
+        MurmurHash3_x64_128(bytes + offset, chunkSize, hashSeed, out);
+        chunkHashes.push_back(out[0]);
+        chunkHashes.push_back(out[1]);
+    }
+    chunkHashes.push_back(size);
+    uint64_t out[2];
+    MurmurHash3_x64_128(&chunkHashes[0], chunkHashes.size() * sizeof(uint64_t), hashSeed, out);
+    return out[0];
+}
+
+uint32_t PackageIndex::find(uint64_t nameHash) const {
+    if(mNumEntries == 0) {
+        return npos;
+    }
+    uint32_t displacement = readU32(mBuckets + (nameHash % mNumBuckets) * 4);
+    uint32_t slot = indexSlot(nameHash, displacement, mNumEntries);
+    if(readU64(mRecords + slot * indexRecordSize) != nameHash) {
+        return npos;
+    }
+    return slot;
+}
+
+uint32_t PackageIndex::find(const std::string& name) const {
+    uint32_t slot = find(hashName(name));
+    if(slot == npos) {
+        return npos;
+    }
+    IndexRecord record = getRecord(slot);
+    if(name.size() != record.nameSize 
+            || std::memcmp(name.data(), record.name, record.nameSize) != 0) {
+        return npos;
+    }
+    return slot;
+}
+
+uint32_t PackageIndex::getNumEntries() const {
+    return mNumEntries;
+}
+
+IndexRecord PackageIndex::getRecord(uint32_t slot) const {
+    const uint8_t* data = mRecords + slot * indexRecordSize;
+    IndexRecord record;
+    record.nameHash = readU64(data);
+    record.name = mStrings + readU32(data + 8);
+    record.nameSize = readU32(data + 12);
+    record.typeId = readU32(data + 16);
+    record.codec = readU32(data + 20);
+    record.file = mStrings + readU32(data + 24);
+    record.fileSize = readU32(data + 28);
+    record.offset = readU64(data + 32);
+    record.size = readU64(data + 40);
+    record.rawSize = readU64(data + 48);
+    record.checksum = readU64(data + 56);
+    return record;
+}
+
+uint32_t PackageIndex::findType(const std::string& type) const {
+    for(uint32_t typeId = 0; typeId < mNumTypes; ++ typeId) {
+        if(getTypeName(typeId) == type) {
+            return typeId;
+        }
+    }
+    return npos;
+}
+
+std::string PackageIndex::getTypeName(uint32_t typeId) const {
+    const uint8_t* data = mTypes + typeId * 8;
+    return getString(readU32(data), readU32(data + 4));
+}
+
+uint32_t PackageIndex::getResourceVersion() const {
+    return mResourceVersion;
+}
+
+bool PackageIndex::hasMerkleRoot() const {
+    return (mFlags & indexFlagMerkleRoot) != 0;
+}
+
+uint64_t PackageIndex::getMerkleRoot() const {
+    return mMerkleRoot;
+}
+
+bool PackageIndex::verifyMerkleRoot() const {
+    if(!hasMerkleRoot()) {
+        return false;
+    }
+    std::vector<uint64_t> level;
+    for(uint32_t slot = 0; slot < mNumEntries; ++ slot) {
+        level.push_back(readU64(mRecords + slot * indexRecordSize + 56));
+    }
+    while(level.size() > 1) {
+        std::vector<uint64_t> parents;
+        for(std::size_t i = 0; i + 1 < level.size(); i += 2) {
+            parents.push_back(merkleParent(level[i], level[i + 1]));
+        }
+        if(level.size() % 2 == 1) {
+            parents.push_back(level.back());
+        }
+        level.swap(parents);
+    }
+    uint64_t root = level.empty() ? 0 : level[0];
+    return root == mMerkleRoot;
+}
+
+std::string PackageIndex::getString(uint32_t offset, uint32_t size) const {
+    if(offset + (uint64_t) size > mStringsSize) {
+        return std::string();
+    }
+    return std::string(mStrings + offset, size);
+}
@@ -0,0 +1,85 @@
+#ifndef PACKAGEINDEX_HPP
+#define PACKAGEINDEX_HPP
+
+#include <stdint.h>
+#include <string>
+
+#include <boost/filesystem.hpp>
+
+#include "MappedFile.hpp"
+
+// One entry of the index, pointing into the mapped file
+struct IndexRecord {
+    uint64_t nameHash;
+    const char* name;
+    uint32_t nameSize;
+    uint32_t typeId;
+    uint32_t codec;
+    const char* file;
+    uint32_t fileSize;
+    uint64_t offset;
+    uint64_t size;
+    uint64_t rawSize;
+    uint64_t checksum;
+};
+
+// The binary data.index written by resman. Lookups hash the name and probe a
+// minimal perfect hash table, so nothing is parsed when the index is opened,
+// only checked to stay within the file. See resman's main/Index.hpp for the
+// layout.
+class PackageIndex {
+private:
+    MappedFile mFile;
+    uint32_t mNumEntries;
+    uint32_t mNumBuckets;
+    uint32_t mNumTypes;
+    const uint8_t* mTypes;
+    const uint8_t* mBuckets;
+    const uint8_t* mRecords;
+    const char* mStrings;
+    uint64_t mStringsSize;
+    uint32_t mFlags;
+    uint32_t mResourceVersion;
+    uint64_t mMerkleRoot;
+    
+    std::string getString(uint32_t offset, uint32_t size) const;
+public:
+    static const uint32_t npos = 0xffffffff;
+    
+    PackageIndex();
+    
+    bool open(const boost::filesystem::path& file);
+    
+    // Must match resman's hash_name()
+    static uint64_t hashName(const std::string& name);
+    
+    // Must match resman's checksum_data()
+    static uint64_t checksum(const void* data, std::size_t size);
+    
+    // Returns the slot of the record with this name, or npos
+    uint32_t find(const std::string& name) const;
+    
+    // Same, but only compares hashes
+    uint32_t find(uint64_t nameHash) const;
+    
+    uint32_t getNumEntries() const;
+    IndexRecord getRecord(uint32_t slot) const;
+    
+    // Returns the id of a type, or npos if no entry has that type
+    uint32_t findType(const std::string& type) const;
+    std::string getTypeName(uint32_t typeId) const;
+    
+    // The package's "fversion" packed as major << 16 | minor << 8 | patch,
+    // zero if the index is older than that field
+    uint32_t getResourceVersion() const;
+    
+    // Whether the index has a Merkle root over the entry checksums
+    bool hasMerkleRoot() const;
+    uint64_t getMerkleRoot() const;
+    
+    // Recomputes the Merkle root from the records. Compare getMerkleRoot()
+    // to a trusted copy as well to know the checksums are genuine.
+    bool verifyMerkleRoot() const;
+};
+
+#endif // PACKAGEINDEX_HPP
@@ -0,0 +1,44 @@
+#include "ParsedResource.hpp"
+
+#include <iostream>
+
+ParsedResource::ParsedResource()
+: mVersion(0) {
+}
+
+ParsedResource::~ParsedResource() {
+}
+
+void ParsedResource::setFormatVersion(const FormatVersion* version) {
+    mVersion = version;
+}
+
+bool ParsedResource::load() {
+    if(this->getBytes()) {
+        return true;
+    }
+    
+    if(!mVersion || !mVersion->isSupported()) {
+        std::cout << "Unsupported format version " 
+            << (mVersion ? mVersion->toString() : "(none)") 
+            << ", expected " << FormatVersion::newest().toString()
+            << ": " << this->getName() << std::endl;
+        return false;
+    }
+    
+    if(!BlobResource::load()) {
+        return false;
+    }
+    if(!this->parse(this->getBytes(), this->getRawSize())) {
+        std::cout << "Malformed resource: " << this->getName() << std::endl;
+        this->clear();
+        BlobResource::unload();
+        return false;
+    }
+    return true;
+}
+
+bool ParsedResource::unload() {
+    this->clear();
+    return BlobResource::unload();
+}
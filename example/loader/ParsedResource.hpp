@@ -0,0 +1,30 @@
+#ifndef PARSEDRESOURCE_HPP
+#define PARSEDRESOURCE_HPP
+
+#include "BlobResource.hpp"
+#include "FormatVersion.hpp"
+
+// A resource made by one of resman's converters, parsed straight from the
+// mapped file. Every kind checks the package's format version here before
+// parsing anything, so a stale package fails to load instead of being
+// misread.
+class ParsedResource : public BlobResource {
+private:
+    const FormatVersion* mVersion;
+protected:
+    // The bytes stay mapped until clear() is called, so anything parsed may
+    // point into them
+    virtual bool parse(const uint8_t* data, std::size_t size) = 0;
+    virtual void clear() = 0;
+public:
+    ParsedResource();
+    virtual ~ParsedResource();
+    
+    // Version of the package this resource is in. Nothing loads without one.
+    void setFormatVersion(const FormatVersion* version);
+    
+    bool load();
+    bool unload();
+};
+
+#endif // PARSEDRESOURCE_HPP
@@ -1,9 +1,62 @@
 #include "Resource.hpp"
 
 #include <cassert>
+#include <iostream>
+
+#include "PackageIndex.hpp"
+
+Residency::Residency()
+: mResidentBytes(0)
+, mCaching(false) {
+}
+
+void Residency::setCaching(bool caching) {
+    mCaching = caching;
+}
+bool Residency::isCaching() const {
+    return mCaching;
+}
+
+void Residency::push(Resource* res) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mQueued.push_back(res);
+}
+
+void Residency::takeAll(std::vector<Resource*>& out) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        out.swap(mQueued);
+        mQueued.clear();
+    }
+    
+    // So that the next drop queues them again, keeping track of recency
+    for(std::size_t i = 0; i < out.size(); ++ i) {
+        out[i]->mUnloadQueued = false;
+    }
+}
+
+void Residency::addBytes(uint64_t bytes) {
+    mResidentBytes += bytes;
+}
+void Residency::removeBytes(uint64_t bytes) {
+    mResidentBytes -= bytes;
+}
+uint64_t Residency::getResidentBytes() const {
+    return mResidentBytes;
+}
 
 Resource::Resource()
-: mNumGrabs(0) { }
+: mNumGrabs(0)
+, mState(UNLOADED)
+, mUnloadQueued(false)
+, mResidency(0)
+, mResidentBytes(0)
+, mFileSize(0)
+, mOffset(0)
+, mCodec(0)
+, mRawSize(0)
+, mChecksum(0)
+, mVerified(false) { }
 Resource::~Resource() { }
 
 void Resource::setFile(const boost::filesystem::path& file) {
@@ -25,20 +78,114 @@ void Resource::setSize(uint32_t size) {
 const uint32_t& Resource::getSize() {
     return mFileSize;
 }
+void Resource::setOffset(uint64_t offset) {
+    mOffset = offset;
+}
+const uint64_t& Resource::getOffset() {
+    return mOffset;
+}
+void Resource::setCodec(uint32_t codec) {
+    mCodec = codec;
+}
+const uint32_t& Resource::getCodec() {
+    return mCodec;
+}
+void Resource::setRawSize(uint32_t rawSize) {
+    mRawSize = rawSize;
+}
+uint32_t Resource::getRawSize() {
+    return mCodec == 0 ? mFileSize : mRawSize;
+}
 
-void Resource::grab() {
+void Resource::setChecksum(uint64_t checksum) {
+    mChecksum = checksum;
+}
+const uint64_t& Resource::getChecksum() {
+    return mChecksum;
+}
+
+bool Resource::verify(const void* data, std::size_t size) {
+    if(mVerified || mChecksum == 0) {
+        return true;
+    }
+    if(PackageIndex::checksum(data, size) != mChecksum) {
+        std::cout << "Checksum mismatch, file is corrupt: " << mName << std::endl;
+        return false;
+    }
+    mVerified = true;
+    return true;
+}
+
+void Resource::setResidency(Residency* residency) {
+    mResidency = residency;
+}
+
+bool Resource::grab() {
     ++ mNumGrabs;
     
-    if(mNumGrabs > 0) {
-        this->load();
+    // Already loaded, nothing to wait for. The count is raised before the
+    // state is read, which together with unloadIfUnused() setting the state
+    // before reading the count means that at least one of the two sees the
+    // other.
+    if(mState == LOADED) {
+        return true;
     }
+    
+    std::lock_guard<std::mutex> lock(mLoadMutex);
+    if(mState != LOADED) {
+        // A failed load stays unloaded so that the next grab tries again
+        if(this->load()) {
+            mResidentBytes = this->getMemoryUsage();
+            if(mResidency) {
+                mResidency->addBytes(mResidentBytes);
+            }
+            mState = LOADED;
+        }
+    }
+    return mState == LOADED;
 }
 
 void Resource::drop() {
-    assert(mNumGrabs != 0);
-    -- mNumGrabs;
+    uint32_t previous = mNumGrabs --;
+    assert(previous != 0);
     
-    if(mNumGrabs == 0) {
-        this->unload();
+    if(previous == 1) {
+        if(!mResidency || !mResidency->isCaching()) {
+            this->unloadIfUnused();
+        } else if(!mUnloadQueued.exchange(true)) {
+            mResidency->push(this);
+        }
     }
 }
+
+bool Resource::isLoaded() const {
+    return mState == LOADED;
+}
+
+bool Resource::unloadIfUnused() {
+    std::lock_guard<std::mutex> lock(mLoadMutex);
+    
+    if(mState != LOADED) {
+        return false;
+    }
+    
+    // Grabs that saw LOADED before this are visible in the count, and any
+    // later grab sees UNLOADING and waits for the mutex
+    mState = UNLOADING;
+    if(mNumGrabs != 0) {
+        mState = LOADED;
+        return false;
+    }
+    
+    this->unload();
+    if(mResidency) {
+        mResidency->removeBytes(mResidentBytes);
+    }
+    mResidentBytes = 0;
+    mState = UNLOADED;
+    return true;
+}
+
+uint64_t Resource::getMemoryUsage() {
+    return 0;
+}
@@ -3,12 +3,65 @@
 
 #include <stdint.h>
 
+#include <atomic>
+#include <mutex>
+#include <vector>
+
 #include <boost/filesystem.hpp>
 
+class Resource;
+
+// Shared by all resources of one manager. Counts the bytes held by loaded
+// resources and, while caching, queues resources whose last grab was
+// dropped. Those stay loaded until the owner empties the queue, so that a
+// drop never unloads something another thread is about to grab again.
+// Without caching the last drop unloads right away.
+class Residency {
+private:
+    std::mutex mMutex;
+    std::vector<Resource*> mQueued;
+    std::atomic<uint64_t> mResidentBytes;
+    std::atomic<bool> mCaching;
+public:
+    Residency();
+    
+    void setCaching(bool caching);
+    bool isCaching() const;
+    
+    void push(Resource* res);
+    void takeAll(std::vector<Resource*>& out);
+    
+    void addBytes(uint64_t bytes);
+    void removeBytes(uint64_t bytes);
+    uint64_t getResidentBytes() const;
+};
+
 class Resource {
 private:
-    uint32_t mNumGrabs;
+    enum State {
+        UNLOADED,
+        LOADED,
+        UNLOADING
+    };
+    
+    // The count and the state are only ever touched atomically, so that
+    // grabbing something already loaded never takes a lock. The mutex is
+    // only held while actually loading or unloading.
+    std::atomic<uint32_t> mNumGrabs;
+    std::atomic<int> mState;
+    std::atomic<bool> mUnloadQueued;
+    std::mutex mLoadMutex;
+    Residency* mResidency;
+    uint64_t mResidentBytes;
+    
+    friend class Residency;
+    
     uint32_t mFileSize;
+    uint64_t mOffset;
+    uint32_t mCodec;
+    uint32_t mRawSize;
+    uint64_t mChecksum;
+    bool mVerified;
     std::string mName;
     boost::filesystem::path mFile;
 public:
@@ -22,11 +75,48 @@ public:
     void setSize(uint32_t size);
     const uint32_t& getSize();
     
-    void grab();
+    // Where the resource starts in its file, non-zero inside archives
+    void setOffset(uint64_t offset);
+    const uint64_t& getOffset();
+    
+    // See Codec, non-zero if the bytes are compressed
+    void setCodec(uint32_t codec);
+    const uint32_t& getCodec();
+    
+    // Size once decompressed. Same as getSize() if it is not compressed.
+    void setRawSize(uint32_t rawSize);
+    uint32_t getRawSize();
+    
+    // Checksum of the bytes as stored, zero if unknown
+    void setChecksum(uint64_t checksum);
+    const uint64_t& getChecksum();
+    
+    // Compares freshly read bytes to the checksum. Only the first load is
+    // checked; after that the bytes are trusted.
+    bool verify(const void* data, std::size_t size);
+    
+    // Dropping the last grab queues the resource here instead of unloading
+    // it right away. Without one it is unloaded inside drop().
+    void setResidency(Residency* residency);
+    
+    // Safe to call from any thread. The first grab loads the resource and
+    // any other thread grabbing it meanwhile waits for that load instead of
+    // starting its own. Returns false if the resource could not be loaded.
+    // It is grabbed either way and must still be dropped.
+    bool grab();
     void drop();
+    bool isLoaded() const;
     
+    // Unloads the resource if nothing has grabbed it since it was queued.
+    // Returns true if it was unloaded.
+    bool unloadIfUnused();
+    
+    // Only called with the load mutex held, at most once at a time
     virtual bool load() = 0;
     virtual bool unload() = 0;
+    
+    // Bytes held while loaded, counted against the manager's memory budget
+    virtual uint64_t getMemoryUsage();
 };
 
 #endif // RESOURCE_HPP
@@ -1,13 +1,57 @@
 #include "ResourceManager.hpp"
 
+#include <algorithm>
+#include <cstdlib>
 #include <fstream>
 
 #include "json/json.h"
 
-ResourceManager::ResourceManager() {
+#include "Decompress.hpp"
+
+namespace {
+
+Json::Value readPackage(const boost::filesystem::path& dataPackFile) {
+    Json::Value dataPackData;
+    std::ifstream reader(dataPackFile.c_str());
+    reader >> dataPackData;
+    reader.close();
+    return dataPackData;
+}
+
+FormatVersion readFormatVersion(const Json::Value& versionData) {
+    return FormatVersion(versionData["major"].asUInt(), 
+        versionData["minor"].asUInt(), versionData["patch"].asUInt());
+}
+
+}
+
+ResourceManager::ResourceManager()
+: mPermaloadThreshold(0)
+, mIndexed(false)
+, mTextTypeId(PackageIndex::npos)
+, mMemoryBudget(0)
+, mLoadService(0)
+, mNumLoadThreads(2)
+, mVerifying(false)
+, mStopVerifying(false) {
 }
 
 ResourceManager::~ResourceManager() {
+    // Finishes any load in progress before the resources go away
+    delete mLoadService;
+    mStopVerifying = true;
+    if(mVerifier.joinable()) {
+        mVerifier.join();
+    }
+    for(std::size_t i = 0; i < mIndexedResources.size(); ++ i) {
+        delete mIndexedResources[i];
+    }
+    for(std::map<std::string, TextResource*>::iterator iter = mTexts.begin(); iter != mTexts.end(); ++ iter) {
+        delete iter->second;
+    }
+    for(std::map<std::string, BlobResource*>::iterator iter = mBlobs.begin(); iter != mBlobs.end(); ++ iter) {
+        delete iter->second;
+    }
 }
 
 void ResourceManager::setPermaloadThreshold(uint32_t size) {
@@ -17,14 +61,95 @@ const uint32_t& ResourceManager::getPermaloadThreshold() {
     return mPermaloadThreshold;
 }
 
+void ResourceManager::permaload(Resource* res) {
+    recordAccess(res);
+    res->grab();
+    if(mMemoryBudget > 0) {
+        res->drop();
+    }
+}
+
+void ResourceManager::setMemoryBudget(uint64_t bytes) {
+    mMemoryBudget = bytes;
+    mResidency.setCaching(bytes > 0);
+}
+const uint64_t& ResourceManager::getMemoryBudget() {
+    return mMemoryBudget;
+}
+
+uint64_t ResourceManager::getMemoryUsage() const {
+    return mResidency.getResidentBytes();
+}
+
+bool ResourceManager::setAccessTrace(const boost::filesystem::path& file) {
+    mAccessTrace.open(file.c_str(), std::ios::out | std::ios::trunc);
+    mTraced.clear();
+    return mAccessTrace.is_open();
+}
+
+void ResourceManager::recordAccess(Resource* res) {
+    if(!res) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mLookupMutex);
+    if(!mAccessTrace.is_open()) {
+        return;
+    }
+    if(mTraced.insert(res).second) {
+        mAccessTrace << res->getName() << std::endl;
+    }
+}
+
+std::size_t ResourceManager::unloadUnused() {
+    std::vector<Resource*> queued;
+    mResidency.takeAll(queued);
+    
+    std::lock_guard<std::mutex> lock(mCacheMutex);
+    
+    // Queued in the order they were dropped, so the last one ends up in front
+    for(std::size_t i = 0; i < queued.size(); ++ i) {
+        Resource* res = queued[i];
+        std::map<Resource*, std::list<Resource*>::iterator>::iterator pos = mCachedPos.find(res);
+        if(pos != mCachedPos.end()) {
+            mCached.splice(mCached.begin(), mCached, pos->second);
+        } else if(res->isLoaded()) {
+            mCached.push_front(res);
+            mCachedPos[res] = mCached.begin();
+        }
+    }
+    
+    // Anything grabbed again since it was dropped is only taken off the
+    // list. Its next drop puts it back in front. Without a budget even
+    // resources that take up no memory of their own, like blobs, go.
+    std::size_t numUnloaded = 0;
+    while(!mCached.empty() && (mMemoryBudget == 0 
+            || mResidency.getResidentBytes() > mMemoryBudget)) {
+        Resource* res = mCached.back();
+        mCached.pop_back();
+        mCachedPos.erase(res);
+        if(res->unloadIfUnused()) {
+            ++ numUnloaded;
+        }
+    }
+    return numUnloaded;
+}
+
 void ResourceManager::mapAll(boost::filesystem::path dataPackFile) {
-    Json::Value dataPackData;
-    {
-        std::ifstream reader(dataPackFile.c_str());
-        reader >> dataPackData;
-        reader.close();
+    mDataDir = dataPackFile.parent_path();
+    if(mIndex.open(mDataDir / "data.index")) {
+        mFormatVersion = FormatVersion::unpack(mIndex.getResourceVersion());
+        
+        // Indices from before the version was stored in them
+        if(!mFormatVersion.isKnown()) {
+            mFormatVersion = readFormatVersion(readPackage(dataPackFile)["fversion"]);
+        }
+        mapIndexed();
+        return;
     }
     
+    Json::Value dataPackData = readPackage(dataPackFile);
+    mFormatVersion = readFormatVersion(dataPackData["fversion"]);
+    
     boost::filesystem::path dataPackDir = dataPackFile.parent_path();
     
     const Json::Value& resourcesData = dataPackData["resources"];
@@ -33,27 +158,314 @@ void ResourceManager::mapAll(boost::filesystem::path dataPackFile) {
         const Json::Value& resourceData = *iter;
         
         std::string resType = resourceData["type"].asString();
-        std::string name = resourceData["name"].asString();
+        std::string name = iter.key().asString();
         std::string file = resourceData["file"].asString();
         uint32_t size = resourceData["size"].asInt();
+        uint64_t offset = resourceData["offset"].asUInt64();
         
         Resource* newRes;
         if(resType == "text") {
             newRes = mTexts[name] = new TextResource();
         } else {
-            newRes = mMiscs[name] = new MiscResource();
+            newRes = mBlobs[name] = newBlob(resType);
         }
         
         newRes->setName(name);
+        newRes->setResidency(&mResidency);
         newRes->setFile(dataPackDir / file);
         newRes->setSize(size);
+        newRes->setOffset(offset);
+        if(resourceData["codec"].isString()) {
+            newRes->setCodec(parseCodec(resourceData["codec"].asString()));
+            newRes->setRawSize(resourceData["raw-size"].asUInt());
+        }
+        if(resourceData["checksum"].isString()) {
+            newRes->setChecksum(std::strtoull(resourceData["checksum"].asCString(), 0, 16));
+        }
         if(size < mPermaloadThreshold) {
-            newRes->grab();
+            permaload(newRes);
         }
         
     }
 }
 
-TextResource* ResourceManager::findText(std::string name) {
-    return mTexts[name];
+BlobResource* ResourceManager::newBlob(const std::string& type) {
+    ParsedResource* parsed = 0;
+    if(type == "geometry") {
+        parsed = new GeometryResource();
+    } else if(type == "font") {
+        parsed = new FontResource();
+    } else if(type == "image") {
+        parsed = new ImageResource();
+    } else if(type == "waveform") {
+        parsed = new WaveformResource();
+    }
+    
+    BlobResource* res = parsed;
+    if(parsed) {
+        parsed->setFormatVersion(&mFormatVersion);
+    } else {
+        res = new MiscResource();
+    }
+    res->setMappedFiles(&mMappedFiles);
+    return res;
+}
+
+const FormatVersion& ResourceManager::getFormatVersion() {
+    return mFormatVersion;
+}
+
+void ResourceManager::mapIndexed() {
+    mIndexed = true;
+    mTextTypeId = mIndex.findType("text");
+    mIndexedResources.assign(mIndex.getNumEntries(), 0);
+    
+    if(mPermaloadThreshold > 0) {
+        for(uint32_t slot = 0; slot < mIndex.getNumEntries(); ++ slot) {
+            if(mIndex.getRecord(slot).size < mPermaloadThreshold) {
+                permaload(getIndexed(slot));
+            }
+        }
+    }
+}
+
+Resource* ResourceManager::getIndexed(uint32_t slot) {
+    std::lock_guard<std::mutex> lock(mLookupMutex);
+    Resource*& res = mIndexedResources[slot];
+    if(res) {
+        return res;
+    }
+    
+    IndexRecord record = mIndex.getRecord(slot);
+    if(record.typeId == mTextTypeId) {
+        res = new TextResource();
+    } else {
+        res = newBlob(mIndex.getTypeName(record.typeId));
+    }
+    res->setName(std::string(record.name, record.nameSize));
+    res->setResidency(&mResidency);
+    res->setFile(mDataDir / std::string(record.file, record.fileSize));
+    res->setSize(record.size);
+    res->setOffset(record.offset);
+    res->setCodec(record.codec);
+    res->setRawSize(record.rawSize);
+    res->setChecksum(record.checksum);
+    return res;
+}
+
+TextResource* ResourceManager::findText(const std::string& name) {
+    if(mIndexed) {
+        uint32_t slot = mIndex.find(name);
+        if(slot == PackageIndex::npos 
+                || mIndex.getRecord(slot).typeId != mTextTypeId) {
+            return 0;
+        }
+        TextResource* res = static_cast<TextResource*>(getIndexed(slot));
+        recordAccess(res);
+        return res;
+    }
+    
+    std::map<std::string, TextResource*>::iterator iter = mTexts.find(name);
+    if(iter == mTexts.end()) {
+        return 0;
+    }
+    recordAccess(iter->second);
+    return iter->second;
+}
+
+TextResource* ResourceManager::findText(uint64_t id) {
+    if(!mIndexed) {
+        return 0;
+    }
+    uint32_t slot = mIndex.find(id);
+    if(slot == PackageIndex::npos 
+            || mIndex.getRecord(slot).typeId != mTextTypeId) {
+        return 0;
+    }
+    TextResource* res = static_cast<TextResource*>(getIndexed(slot));
+    recordAccess(res);
+    return res;
+}
+
+BlobResource* ResourceManager::findBlob(const std::string& name) {
+    if(mIndexed) {
+        uint32_t slot = mIndex.find(name);
+        if(slot == PackageIndex::npos 
+                || mIndex.getRecord(slot).typeId == mTextTypeId) {
+            return 0;
+        }
+        BlobResource* res = static_cast<BlobResource*>(getIndexed(slot));
+        recordAccess(res);
+        return res;
+    }
+    
+    std::map<std::string, BlobResource*>::iterator iter = mBlobs.find(name);
+    if(iter == mBlobs.end()) {
+        return 0;
+    }
+    recordAccess(iter->second);
+    return iter->second;
+}
+
+BlobResource* ResourceManager::findBlob(uint64_t id) {
+    if(!mIndexed) {
+        return 0;
+    }
+    uint32_t slot = mIndex.find(id);
+    if(slot == PackageIndex::npos 
+            || mIndex.getRecord(slot).typeId == mTextTypeId) {
+        return 0;
+    }
+    BlobResource* res = static_cast<BlobResource*>(getIndexed(slot));
+    recordAccess(res);
+    return res;
+}
+
+GeometryResource* ResourceManager::findGeometry(const std::string& name) {
+    return dynamic_cast<GeometryResource*>(findBlob(name));
+}
+GeometryResource* ResourceManager::findGeometry(uint64_t id) {
+    return dynamic_cast<GeometryResource*>(findBlob(id));
+}
+FontResource* ResourceManager::findFont(const std::string& name) {
+    return dynamic_cast<FontResource*>(findBlob(name));
+}
+FontResource* ResourceManager::findFont(uint64_t id) {
+    return dynamic_cast<FontResource*>(findBlob(id));
+}
+ImageResource* ResourceManager::findImage(const std::string& name) {
+    return dynamic_cast<ImageResource*>(findBlob(name));
+}
+ImageResource* ResourceManager::findImage(uint64_t id) {
+    return dynamic_cast<ImageResource*>(findBlob(id));
+}
+WaveformResource* ResourceManager::findWaveform(const std::string& name) {
+    return dynamic_cast<WaveformResource*>(findBlob(name));
+}
+WaveformResource* ResourceManager::findWaveform(uint64_t id) {
+    return dynamic_cast<WaveformResource*>(findBlob(id));
+}
+
+void ResourceManager::setNumLoadThreads(uint32_t numThreads) {
+    mNumLoadThreads = numThreads;
+}
+
+Resource* ResourceManager::findAny(const std::string& name) {
+    if(mIndexed) {
+        uint32_t slot = mIndex.find(name);
+        if(slot == PackageIndex::npos) {
+            return 0;
+        }
+        return getIndexed(slot);
+    }
+    
+    std::map<std::string, TextResource*>::iterator textIter = mTexts.find(name);
+    if(textIter != mTexts.end()) {
+        return textIter->second;
+    }
+    std::map<std::string, BlobResource*>::iterator blobIter = mBlobs.find(name);
+    if(blobIter != mBlobs.end()) {
+        return blobIter->second;
+    }
+    return 0;
+}
+
+std::shared_future<Resource*> ResourceManager::requestLoad(Resource* res, int priority) {
+    if(!res) {
+        std::promise<Resource*> missing;
+        missing.set_value(0);
+        return missing.get_future().share();
+    }
+    recordAccess(res);
+    if(!mLoadService) {
+        mLoadService = new LoadService(mNumLoadThreads);
+    }
+    return mLoadService->request(res, priority);
+}
+
+std::shared_future<Resource*> ResourceManager::requestLoad(const std::string& name, int priority) {
+    return requestLoad(findAny(name), priority);
+}
+
+std::shared_future<Resource*> ResourceManager::requestLoad(uint64_t id, int priority) {
+    Resource* res = 0;
+    if(mIndexed) {
+        uint32_t slot = mIndex.find(id);
+        if(slot != PackageIndex::npos) {
+            res = getIndexed(slot);
+        }
+    }
+    return requestLoad(res, priority);
+}
+
+bool ResourceManager::startVerifying() {
+    if(!mIndexed || mVerifier.joinable()) {
+        return false;
+    }
+    mVerifying = true;
+    mVerifier = std::thread(&ResourceManager::verifyAll, this);
+    return true;
+}
+
+bool ResourceManager::isVerifying() const {
+    return mVerifying;
+}
+
+std::vector<std::string> ResourceManager::getCorrupt() {
+    std::lock_guard<std::mutex> lock(mCorruptMutex);
+    return mCorrupt;
+}
+
+namespace {
+
+struct SlotOrder {
+    const PackageIndex* index;
+    bool operator()(uint32_t a, uint32_t b) const {
+        IndexRecord ra = index->getRecord(a);
+        IndexRecord rb = index->getRecord(b);
+        int cmp = std::string(ra.file, ra.fileSize).compare(std::string(rb.file, rb.fileSize));
+        if(cmp != 0) {
+            return cmp < 0;
+        }
+        return ra.offset < rb.offset;
+    }
+};
+
+} // namespace
+
+void ResourceManager::verifyAll() {
+    if(mIndex.hasMerkleRoot() && !mIndex.verifyMerkleRoot()) {
+        std::lock_guard<std::mutex> lock(mCorruptMutex);
+        mCorrupt.push_back("data.index");
+    }
+    
+    // Each file is read front to back once
+    std::vector<uint32_t> slots(mIndex.getNumEntries());
+    for(uint32_t slot = 0; slot < slots.size(); ++ slot) {
+        slots[slot] = slot;
+    }
+    SlotOrder order = {&mIndex};
+    std::sort(slots.begin(), slots.end(), order);
+    
+    MappedFile file;
+    std::string fileName;
+    bool fileOpen = false;
+    for(std::size_t i = 0; i < slots.size() && !mStopVerifying; ++ i) {
+        IndexRecord record = mIndex.getRecord(slots[i]);
+        std::string recordFile(record.file, record.fileSize);
+        if(recordFile != fileName) {
+            file.close();
+            fileName = recordFile;
+            fileOpen = file.open(mDataDir / fileName);
+        }
+        bool valid = fileOpen 
+                && record.offset <= file.getSize() 
+                && record.size <= file.getSize() - record.offset
+                && PackageIndex::checksum(file.getData() + record.offset, record.size) == record.checksum;
+        if(!valid) {
+            std::lock_guard<std::mutex> lock(mCorruptMutex);
+            mCorrupt.push_back(std::string(record.name, record.nameSize));
+        }
+    }
+    mVerifying = false;
 }
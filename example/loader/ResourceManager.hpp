@@ -1,31 +1,171 @@
 #ifndef RESOURCEMANAGER_HPP
 #define RESOURCEMANAGER_HPP
 
+#include <atomic>
+#include <fstream>
+#include <list>
 #include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
 
 #include <boost/filesystem.hpp>
 
 #include "Resource.hpp"
 #include "TextResource.hpp"
 #include "MiscResource.hpp"
+#include "BlobResource.hpp"
+#include "GeometryResource.hpp"
+#include "FontResource.hpp"
+#include "ImageResource.hpp"
+#include "WaveformResource.hpp"
+#include "FormatVersion.hpp"
+#include "MappedFile.hpp"
+#include "PackageIndex.hpp"
+#include "LoadService.hpp"
 
 class ResourceManager {
 private:
     std::map<std::string, TextResource*> mTexts;
-    std::map<std::string, MiscResource*> mMiscs;
+    std::map<std::string, BlobResource*> mBlobs;
+    
+    // Checked by every typed resource before it parses anything
+    FormatVersion mFormatVersion;
+    
+    // A typed resource if there is a loader for the type, otherwise misc
+    BlobResource* newBlob(const std::string& type);
     
     uint32_t mPermaloadThreshold;
+    void permaload(Resource* res);
+    
+    // Used instead of the maps above if the package has a binary index.
+    // Resources are only created the first time they are looked up.
+    PackageIndex mIndex;
+    bool mIndexed;
+    boost::filesystem::path mDataDir;
+    uint32_t mTextTypeId;
+    std::vector<Resource*> mIndexedResources;
+    
+    void mapIndexed();
+    Resource* getIndexed(uint32_t slot);
+    
+    // Mappings shared by all blobs in the same archive
+    MappedFileCache mMappedFiles;
+    
+    // Guards creating indexed resources and writing the access trace, so
+    // that lookups can come from any thread
+    std::mutex mLookupMutex;
+    
+    // Loaded resources that nobody has grabbed, most recently dropped
+    // first. The least recently dropped are unloaded once the resident
+    // bytes go over the budget.
+    Residency mResidency;
+    uint64_t mMemoryBudget;
+    std::mutex mCacheMutex;
+    std::list<Resource*> mCached;
+    std::map<Resource*, std::list<Resource*>::iterator> mCachedPos;
+    
+    // Names of resources in the order they were first used
+    std::ofstream mAccessTrace;
+    std::set<Resource*> mTraced;
+    void recordAccess(Resource* res);
+    
+    // Created by the first call to requestLoad()
+    LoadService* mLoadService;
+    uint32_t mNumLoadThreads;
+    Resource* findAny(const std::string& name);
+    std::shared_future<Resource*> requestLoad(Resource* res, int priority);
+    
+    // Checks every indexed entry on a background thread
+    std::thread mVerifier;
+    std::atomic<bool> mVerifying;
+    std::atomic<bool> mStopVerifying;
+    std::mutex mCorruptMutex;
+    std::vector<std::string> mCorrupt;
+    void verifyAll();
     
 public:
     ResourceManager();
     ~ResourceManager();
     
+    // Resources smaller than this are loaded by mapAll(). Without a memory
+    // budget they are kept loaded forever, otherwise they are only cached
+    // like anything else that was dropped.
     void setPermaloadThreshold(uint32_t size);
     const uint32_t& getPermaloadThreshold();
+    
+    // Bytes that loaded resources may take up before dropped ones are
+    // unloaded by unloadUnused(). Resources that are grabbed are never
+    // unloaded, so this can be exceeded. Zero, the default, unloads
+    // everything as soon as it is dropped. Set before mapAll().
+    void setMemoryBudget(uint64_t bytes);
+    const uint64_t& getMemoryBudget();
+    
+    // Bytes taken up by loaded resources, grabbed or not
+    uint64_t getMemoryUsage() const;
+
+    // Records every resource used from now on, which resman can read with
+    // --order to store startup resources next to each other. Call before
+    // mapAll() to include permanently loaded resources.
+    bool setAccessTrace(const boost::filesystem::path& file);
 
     void mapAll(boost::filesystem::path data);
     
-    TextResource* findText(std::string name);
+    // The package's "fversion", known once mapAll() has been called
+    const FormatVersion& getFormatVersion();
+    
+    TextResource* findText(const std::string& name);
+    
+    // Looks up an id from the header generated by resman. Only works if the
+    // package has a binary index.
+    TextResource* findText(uint64_t id);
+    
+    // Any resource that is not text, as a view into the mapped package
+    BlobResource* findBlob(const std::string& name);
+    BlobResource* findBlob(uint64_t id);
+    
+    // Typed resources, parsed from the mapped package when grabbed. They
+    // fail to load if the package was made for another format version.
+    GeometryResource* findGeometry(const std::string& name);
+    GeometryResource* findGeometry(uint64_t id);
+    FontResource* findFont(const std::string& name);
+    FontResource* findFont(uint64_t id);
+    ImageResource* findImage(const std::string& name);
+    ImageResource* findImage(uint64_t id);
+    WaveformResource* findWaveform(const std::string& name);
+    WaveformResource* findWaveform(uint64_t id);
+    
+    // Unloads the least recently dropped resources that nobody has grabbed
+    // since, until the memory usage fits in the budget. With a budget,
+    // dropping never unloads by itself, so call this once in a while, e.g.
+    // once per frame. Grabbing a cached resource again costs nothing. Safe
+    // to call from any thread. Returns the number of resources unloaded.
+    std::size_t unloadUnused();
+    
+    // Number of I/O threads used by requestLoad(). Only takes effect if set
+    // before the first request.
+    void setNumLoadThreads(uint32_t numThreads);
+    
+    // Grabs a resource of any type on an I/O thread, so that the caller is
+    // never blocked by the disk. Use a low priority for prefetching. The
+    // future resolves to the loaded resource, which the caller must drop
+    // when done, or to 0 if it does not exist or failed to load.
+    std::shared_future<Resource*> requestLoad(const std::string& name, int priority = 0);
+    
+    // Same, by an id from the header generated by resman. Only works if the
+    // package has a binary index.
+    std::shared_future<Resource*> requestLoad(uint64_t id, int priority = 0);
+    
+    // Checks the checksum of every entry on a background thread, so that a
+    // damaged download is caught without hashing everything at startup.
+    // Only works if the package has a binary index.
+    bool startVerifying();
+    bool isVerifying() const;
+    
+    // Names of the entries found to be damaged so far. "data.index" itself
+    // is listed if its Merkle root does not match its records.
+    std::vector<std::string> getCorrupt();
 };
 
 
@@ -2,7 +2,8 @@
 
 #include <fstream>
 #include <iostream>
-#include <sstream>
+
+#include "Decompress.hpp"
 
 TextResource::TextResource()
 : mLoaded(false) {
@@ -16,22 +17,47 @@ bool TextResource::load() {
         return true;
     }
     
-    std::ifstream loader(this->getFile().c_str());
-    std::stringstream ss;
-    ss << loader.rdbuf();
-    loader.close();
+    if(!isCodecAvailable(this->getCodec())) {
+        std::cout << "Codec not available: " << this->getName() << std::endl;
+        return false;
+    }
     
-    mData = ss.str();
+    std::string stored(this->getSize(), '\0');
+    std::ifstream loader(this->getFile().c_str(), std::ios::binary);
+    loader.seekg(this->getOffset());
+    loader.read(&stored[0], stored.size());
+    loader.close();
+    if(loader.gcount() != (std::streamsize) stored.size()
+            || !this->verify(stored.data(), stored.size())) {
+        return false;
+    }
     
+    if(this->getCodec() == 0) {
+        mData.swap(stored);
+    } else {
+        mData.resize(this->getRawSize());
+        if(!decompress(this->getCodec(), reinterpret_cast<const uint8_t*>(stored.data()), stored.size(), 
+                reinterpret_cast<uint8_t*>(&mData[0]), mData.size())) {
+            std::cout << "Corrupt compressed data: " << this->getName() << std::endl;
+            std::string().swap(mData);
+            return false;
+        }
+    }
+    mLoaded = true;
     return true;
 }
 
 bool TextResource::unload() {
-    // Text files are not worth unloading, probably...
-    
+    // Swapped so that the memory is actually given back
+    std::string().swap(mData);
+    mLoaded = false;
     return true;
 }
 
+uint64_t TextResource::getMemoryUsage() {
+    return mData.capacity();
+}
+
 const std::string& TextResource::getString() {
     return mData;
 }
@@ -14,6 +14,7 @@ public:
     
     bool load();
     bool unload();
+    uint64_t getMemoryUsage();
     
     const std::string& getString();
 
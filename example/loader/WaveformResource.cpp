@@ -0,0 +1,95 @@
+#include "WaveformResource.hpp"
+
+#include <cstring>
+
+#include "ByteReader.hpp"
+
+namespace {
+
+// Ogg page header up to the segment table
+const std::size_t oggHeaderSize = 27;
+
+// Largest possible page, header and segment table included
+const std::size_t oggMaxPageSize = oggHeaderSize + 255 + 255 * 255;
+
+}
+
+WaveformResource::WaveformResource() {
+    this->clear();
+}
+
+WaveformResource::~WaveformResource() {
+}
+
+bool WaveformResource::parse(const uint8_t* data, std::size_t size) {
+    ByteReader reader(data, size);
+    
+    // The first page holds only the identification header
+    const uint8_t* capture = reader.skip(4);
+    if(!capture || std::memcmp(capture, "OggS", 4) != 0) {
+        return false;
+    }
+    reader.readU8(); // Version
+    reader.readU8(); // Header type
+    reader.readU64(); // Granule position
+    uint32_t serial = reader.readU32();
+    reader.readU32(); // Page sequence number
+    reader.readU32(); // CRC
+    reader.skip(reader.readU8()); // Segment table
+    
+    uint8_t packetType = reader.readU8();
+    const uint8_t* codec = reader.skip(6);
+    if(packetType != 1 || !codec || std::memcmp(codec, "vorbis", 6) != 0 
+            || reader.readU32() != 0) {
+        return false;
+    }
+    mNumChannels = reader.readU8();
+    mSampleRate = reader.readU32();
+    reader.readU32(); // Maximum bitrate
+    mNominalBitrate = (int32_t) reader.readU32();
+    if(reader.hasFailed()) {
+        return false;
+    }
+    
+    // The granule position of the last page of the stream is the number of
+    // samples. Only the last page is touched, so this stays cheap. There is
+    // at least the first page, so the search always starts in bounds.
+    std::size_t searchStart = size > oggMaxPageSize ? size - oggMaxPageSize : 0;
+    std::size_t pos = size - oggHeaderSize;
+    while(true) {
+        if(std::memcmp(data + pos, "OggS", 4) == 0) {
+            ByteReader page(data + pos, size - pos);
+            page.skip(6);
+            uint64_t granule = page.readU64();
+            if(page.readU32() == serial) {
+                mNumSamples = granule;
+                break;
+            }
+        }
+        if(pos == searchStart) {
+            break;
+        }
+        -- pos;
+    }
+    return true;
+}
+
+void WaveformResource::clear() {
+    mNumChannels = 0;
+    mSampleRate = 0;
+    mNominalBitrate = 0;
+    mNumSamples = 0;
+}
+
+uint32_t WaveformResource::getNumChannels() {
+    return mNumChannels;
+}
+uint32_t WaveformResource::getSampleRate() {
+    return mSampleRate;
+}
+int32_t WaveformResource::getNominalBitrate() {
+    return mNominalBitrate;
+}
+uint64_t WaveformResource::getNumSamples() {
+    return mNumSamples;
+}
@@ -0,0 +1,32 @@
+#ifndef WAVEFORMRESOURCE_HPP
+#define WAVEFORMRESOURCE_HPP
+
+#include "ParsedResource.hpp"
+
+// An Ogg Vorbis stream made by resman's convertWaveform. Only the headers
+// are parsed; the stream itself is getBytes(), to be handed to a decoder
+// as it is.
+class WaveformResource : public ParsedResource {
+private:
+    uint32_t mNumChannels;
+    uint32_t mSampleRate;
+    int32_t mNominalBitrate;
+    uint64_t mNumSamples;
+protected:
+    bool parse(const uint8_t* data, std::size_t size);
+    void clear();
+public:
+    WaveformResource();
+    virtual ~WaveformResource();
+    
+    uint32_t getNumChannels();
+    uint32_t getSampleRate();
+    
+    // Bits per second the encoder aimed for, zero if unknown
+    int32_t getNominalBitrate();
+    
+    // Samples per channel, taken from the last page
+    uint64_t getNumSamples();
+};
+
+#endif // WAVEFORMRESOURCE_HPP
@@ -13,15 +13,22 @@ int main(int argc, char* argv[]) {
     boost::filesystem::path data = "../../../example/output/data.package";
     resman.mapAll(data);
     
+    // Starts reading in the background while the couplet is loaded here
+    std::shared_future<Resource*> pending = resman.requestLoad("HelloWorld.text");
+    
     TextResource* couplet = resman.findText("Witches.text");
     couplet->grab();
     std::cout << couplet->getString() << std::endl;
     couplet->drop();
     
-    TextResource* greeting = resman.findText("HelloWorld.text");
-    greeting->grab();
-    std::cout << greeting->getString() << std::endl;
-    greeting->drop();
+    TextResource* greeting = static_cast<TextResource*>(pending.get());
+    if(greeting) {
+        std::cout << greeting->getString() << std::endl;
+        greeting->drop();
+    }
+    
+    // Nothing is grabbed anymore, so both texts can go
+    resman.unloadUnused();
     
     return 0;
 }
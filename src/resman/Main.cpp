@@ -14,23 +14,39 @@
  *  limitations under the License.
  */
 
+#include <chrono>
 #include <fstream>
 #include <sstream>
 #include <cstdint>
+#include <set>
 #include <string>
 #include <vector>
 #include <iostream>
 #include <algorithm>
+#include <cstdlib>
+#include <cctype>
+
+#include <sys/resource.h>
+#include <sys/stat.h>
 
 #include <boost/filesystem.hpp>
 #include <json/json.h>
-#include <MurmurHash3.h>
 
 #include "logger/Logger.hpp"
 #include "main/Convert.hpp"
 #include "main/JsonUtil.hpp"
 #include "main/Common.hpp"
+#include "main/Compress.hpp"
 #include "main/Expand.hpp"
+#include "main/Hash.hpp"
+#include "main/IdHeader.hpp"
+#include "main/Index.hpp"
+#include "main/Pack.hpp"
+#include "main/Patch.hpp"
+#include "main/Publish.hpp"
+#include "main/Watcher.hpp"
+#include "main/Scheduler.hpp"
+#include "main/Trace.hpp"
 
 namespace resman {
 
@@ -44,10 +60,25 @@ void write_format_version(Json::Value& where) {
     where["patch"] = n_fversion_patch;
 }
 
+// Same version as stored in data.index
+uint32_t packed_format_version() {
+    return n_fversion_major << 16 | n_fversion_minor << 8 | n_fversion_patch;
+}
+
 // Useful for debug information, but significantly slows down packaging
 bool n_verbose = true;
 bool n_reset_interm = false;
+bool n_purge_cache = false;
 bool n_clean_output = false;
+uint32_t n_num_jobs = 1;
+uint64_t n_memory_budget = 0;
+bool n_watch = false;
+
+// How long the project tree must be quiet before a watch mode rebuild starts
+uint32_t n_watch_settle_ms = 100;
+
+// Where to write a trace of the run, if anywhere
+boost::filesystem::path n_trace_file;
 
 bool isWorkInProgressType(const OType& type) {
     return false;
@@ -80,6 +111,22 @@ std::map<OType, Convert_Func> n_converters = {
     {"string", convertMiscellaneous}
 };
 
+/* Converters not listed here are assumed to need about as much memory as
+ * their source file, e.g. to read it in whole.
+ */
+std::map<OType, Estimate_Func> n_memory_estimators = {
+    {"image", estimateImageMemory},
+    
+    {"geometry", estimateGeometryMemory}
+};
+
+/* Bump a type's version whenever a change to its converter alters the output,
+ * so that results cached by older builds are not reused. Unlisted types are
+ * at version 0.
+ */
+std::map<OType, uint32_t> n_converter_versions = {
+};
+
 std::map<OType, Expand_Func> n_expanders = {
     {"shader", expand_bgfx_shader}
 };
@@ -94,16 +141,85 @@ std::map<OType, Expand_Func> n_expanders = {
  *          the project's root directory
  *      previous output not overwritten
  *      no intermediate directory / no intermediate data used
+ *      converted data cached in $RESMAN_CACHE_DIR if set, otherwise in
+ *          the "cache" sub-directory of the intermediate directory
  */
 struct Config {
     bool m_obfuscate = false;
     
+    // Whether to output a single archive instead of loose files
+    bool m_pack = false;
+    
+    // How to compress each type in the archive. "*" applies to every type
+    // not listed.
+    std::map<OType, Codec> m_pack_codecs;
+    
+    // Compressed entries that are not at least this fraction smaller are
+    // stored uncompressed instead, so that they can be used in place
+    double m_pack_min_savings = 0.1;
+    
+    // Archives larger than this many bytes are split into numbered volumes.
+    // Zero means no limit.
+    uint64_t m_pack_max_size = 0;
+    
+    // Order in which load groups are stored in the archive. "*" stands for
+    // resources without a group, which otherwise go last.
+    std::vector<std::string> m_load_groups;
+    
+    // Names of resources in the order a loader first used them, one per line
+    boost::filesystem::path m_access_trace;
+    
     std::vector<boost::filesystem::path> m_ignores;
     boost::filesystem::path m_output_dir;
     boost::filesystem::path m_interm_dir;
+    boost::filesystem::path m_cache_dir;
+    
+    // Whether data.index gets a Merkle root over the entry checksums
+    bool m_merkle_root = false;
+    
+    // Generated header of resource ids, and the namespace to put them in
+    boost::filesystem::path m_id_header;
+    std::string m_id_namespace = "resid";
 };
 
-void translateData(const Object& object, bool modifyFilename) {
+/**
+ * @brief Checksums go into json as 16 hex digits, since not every json
+ * reader can hold a 64-bit integer
+ */
+std::string checksum_string(uint64_t checksum) {
+    const char* digits = "0123456789abcdef";
+    std::string retval(16, '0');
+    for (int i = 0; i < 16; ++i) {
+        retval[15 - i] = digits[(checksum >> (i * 4)) & 0xf];
+    }
+    return retval;
+}
+
+uint64_t elapsed_nanos(std::chrono::steady_clock::time_point from, 
+        std::chrono::steady_clock::time_point to) {
+    if (to < from) {
+        return 0;
+    }
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            to - from).count();
+}
+
+/**
+ * @brief Highest resident set size of this process so far, in bytes
+ */
+uint64_t get_peak_rss() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return usage.ru_maxrss;
+#else
+    return ((uint64_t) usage.ru_maxrss) * 1024;
+#endif
+}
+
+void translateData(Object& object, bool modifyFilename) {
     if (!boost::filesystem::exists(object.m_src_file)) {
         std::stringstream sss;
         sss << "File does not exist: "
@@ -121,19 +237,55 @@ void translateData(const Object& object, bool modifyFilename) {
         throw std::runtime_error(sss.str());
     }
     
+    // Converts into a uniquely-named file in the cache which is only moved
+    // into place when complete, so that other resman processes sharing the
+    // cache never see a partially written entry
+    object.m_dependencies.clear();
+    
+    Convert_Stats& stats = object.m_stats;
+    stats = Convert_Stats();
+    stats.m_start = std::chrono::steady_clock::now();
+    
     Convert_Args args;
     args.fromFile = object.m_src_file;
     args.outputFile = object.m_interm_file;
     args.modifyFilename = modifyFilename;
     args.params = object.m_params;
+    args.dependencies = &object.m_dependencies;
+    args.stats = &stats;
     
     Convert_Func& converter = pair_ptr->second;
-    converter(args);
+    try {
+        converter(args);
+        if (!boost::filesystem::exists(object.m_interm_file)) {
+            throw std::runtime_error("Converter did not output anything");
+        }
+    } catch (...) {
+        boost::system::error_code ignored;
+        boost::filesystem::remove(object.m_interm_file, ignored);
+        throw;
+    }
+    
+    auto end = std::chrono::steady_clock::now();
+    auto decoded = stats.m_marked_decoded ? stats.m_decoded : stats.m_start;
+    auto processed = stats.m_marked_processed ? stats.m_processed : end;
+    stats.m_decode_ns = elapsed_nanos(stats.m_start, decoded);
+    stats.m_process_ns = elapsed_nanos(decoded, processed);
+    stats.m_encode_ns = elapsed_nanos(processed, end);
     
-    if (boost::filesystem::exists(object.m_dest_file)) {
-        boost::filesystem::remove(object.m_dest_file);
+    // Never zero, so that a successful translation can be told apart
+    stats.m_total_ns = elapsed_nanos(stats.m_start, end) + 1;
+    
+    boost::system::error_code ignored;
+    stats.m_input_bytes = object.m_src_size;
+    for (const boost::filesystem::path& dependency : object.m_dependencies) {
+        uint64_t size = boost::filesystem::file_size(dependency, ignored);
+        if (!ignored) {
+            stats.m_input_bytes += size;
+        }
     }
-    boost::filesystem::copy(object.m_interm_file, object.m_dest_file);
+    stats.m_output_bytes = boost::filesystem::file_size(object.m_interm_file);
+    stats.m_peak_rss = get_peak_rss();
 }
 
 void recursiveSearch(const boost::filesystem::path& root, 
@@ -189,6 +341,11 @@ private:
         m_conf.m_output_dir = m_package_dir / "__output__";
         m_conf.m_interm_dir = m_package_dir / "__interm__";
         
+        const char* env_cache = std::getenv("RESMAN_CACHE_DIR");
+        if (env_cache && *env_cache) {
+            m_conf.m_cache_dir = env_cache;
+        }
+        
         if (!boost::filesystem::exists(file_config)) {
             return;
         }
@@ -204,11 +361,69 @@ private:
             m_conf.m_obfuscate = json_obfuscate.asBool();
         }
 
+        Json::Value& json_pack = json_config["pack"];
+        if (!json_pack.isNull()) {
+            m_conf.m_pack = json_pack.asBool();
+        }
+
+        Json::Value& json_codec = json_config["pack-codec"];
+        if (json_codec.isString()) {
+            set_pack_codec("*", json_codec.asString());
+        } else if (json_codec.isObject()) {
+            for (auto iter = json_codec.begin(); 
+                    iter != json_codec.end(); ++iter) {
+                set_pack_codec(iter.key().asString(), iter->asString());
+            }
+        }
+        
+        Json::Value& json_min_savings = json_config["pack-min-savings"];
+        if (!json_min_savings.isNull()) {
+            m_conf.m_pack_min_savings = json_min_savings.asDouble();
+        }
+
+        // In megabytes, like -m
+        Json::Value& json_max_size = json_config["pack-max-size"];
+        if (!json_max_size.isNull()) {
+            int64_t megabytes = json_max_size.asInt64();
+            m_conf.m_pack_max_size = megabytes < 0 ? 0 : megabytes << 20;
+        }
+
+        Json::Value& json_load_groups = json_config["load-groups"];
+        for (const Json::Value& json_group : json_load_groups) {
+            m_conf.m_load_groups.push_back(json_group.asString());
+        }
+        
+        Json::Value& json_access_trace = json_config["access-trace"];
+        if (!json_access_trace.isNull()) {
+            m_conf.m_access_trace = 
+                    m_package_dir / (json_access_trace.asString());
+        }
+
+        Json::Value& json_merkle_root = json_config["merkle-root"];
+        if (!json_merkle_root.isNull()) {
+            m_conf.m_merkle_root = json_merkle_root.asBool();
+        }
+
+        Json::Value& json_id_header = json_config["id-header"];
+        if (!json_id_header.isNull()) {
+            m_conf.m_id_header = m_package_dir / (json_id_header.asString());
+        }
+        
+        Json::Value& json_id_namespace = json_config["id-namespace"];
+        if (!json_id_namespace.isNull()) {
+            m_conf.m_id_namespace = json_id_namespace.asString();
+        }
+
         Json::Value& json_interm = json_config["intermediate"];
         if (!json_interm.isNull()) {
             m_conf.m_interm_dir = m_package_dir / (json_interm.asString());
         }
         
+        Json::Value& json_cache = json_config["cache"];
+        if (!json_cache.isNull()) {
+            m_conf.m_cache_dir = m_package_dir / (json_cache.asString());
+        }
+        
         Json::Value& json_ignore_list = json_config["ignore"];
         if (!json_ignore_list.isNull()) {
             for (Json::Value& ignore : json_ignore_list) {
@@ -217,6 +432,17 @@ private:
         }
     }
     
+    Codec find_pack_codec(const OType& type) {
+        auto iter = m_conf.m_pack_codecs.find(type);
+        if (iter == m_conf.m_pack_codecs.end()) {
+            iter = m_conf.m_pack_codecs.find("*");
+        }
+        if (iter == m_conf.m_pack_codecs.end()) {
+            return Codec::NONE;
+        }
+        return iter->second;
+    }
+    
     void verify_obj_field(const char* field,
             const Json::Value& json_obj, 
             const boost::filesystem::path& resdef_file) {
@@ -233,6 +459,28 @@ private:
         }
     }
     
+    /**
+     * @brief Groups name archive files, so keep them to safe characters
+     */
+    void verify_group_name(const std::string& group,
+            const boost::filesystem::path& resdef_file) {
+        bool valid = !group.empty();
+        for (char c : group) {
+            if (!std::isalnum((unsigned char) c) && c != '_' && c != '-') {
+                valid = false;
+            }
+        }
+        if (!valid) {
+            std::stringstream sss;
+            sss << "Invalid group \""
+                << group
+                << "\" in resource declared in "
+                << resdef_file
+                << ", use only letters, digits, '_' and '-'";
+            throw std::runtime_error(sss.str());
+        }
+    }
+    
     void process_resource(const Json::Value& json_obj, 
             const boost::filesystem::path& resdef_file) {
         Object object;
@@ -251,6 +499,17 @@ private:
             object.m_params = json_obj["params"];
         }
         
+        const Json::Value& json_group = json_obj["group"];
+        if (!json_group.isNull()) {
+            object.m_group = json_group.asString();
+            verify_group_name(object.m_group, resdef_file);
+        }
+        
+        const Json::Value& json_load_group = json_obj["load-group"];
+        if (!json_load_group.isNull()) {
+            object.m_load_group = json_load_group.asString();
+        }
+        
         const Json::Value& json_retrans = json_obj["always-retranslate"];
         if (!json_retrans.isNull()) {
             object.m_force_retrans = json_retrans.asBool();
@@ -304,6 +563,14 @@ private:
         } else {
             Logger::log()->info("\tObfuscation: disabled");
         }
+        if (m_conf.m_pack && m_conf.m_pack_max_size > 0) {
+            Logger::log()->info("\tPack archive: enabled, volumes of at most "
+                    "%v bytes", m_conf.m_pack_max_size);
+        } else if (m_conf.m_pack) {
+            Logger::log()->info("\tPack archive: enabled");
+        } else {
+            Logger::log()->info("\tPack archive: disabled");
+        }
     }
     
     void clean_directory(boost::filesystem::path dir) {
@@ -486,57 +753,224 @@ private:
         }
     }
     
-    void hash_file(const boost::filesystem::path& file, uint32_t& src_hash) {
-        std::ifstream sizeTest(file.string().c_str(), 
-                std::ios::binary | std::ios::ate);
-                
-        if (sizeTest.fail()) {
+    /**
+     * @brief Everything about a file that is checked to decide whether it
+     * could have changed since it was last hashed
+     */
+    struct File_Stat {
+        uint64_t m_size = 0;
+        int64_t m_mtime_ns = 0;
+        uint64_t m_inode = 0;
+    };
+    
+    void stat_file(const boost::filesystem::path& file, File_Stat& stat) {
+        struct ::stat info;
+        if (::stat(file.string().c_str(), &info) != 0) {
             std::stringstream sss;
-            sss << "Cannot open file for hashing: "
+            sss << "Cannot stat file: "
                 << file;
             throw std::runtime_error(sss.str());
         }
-                
-        std::ios::pos_type src_size = sizeTest.tellg();
-
-        char* totalData = new char[src_size];
-        sizeTest.seekg(0, std::ios::beg);
-        sizeTest.read(totalData, src_size);
-        sizeTest.close();
-
-        MurmurHash3_x86_32(totalData, src_size, 0xdaff0d11, &src_hash);
-
-        delete[] totalData;
+        stat.m_size = info.st_size;
+        stat.m_inode = info.st_ino;
+        stat.m_mtime_ns = ((int64_t) info.st_mtime) * 1000000000;
+#if defined(__linux__)
+        stat.m_mtime_ns += info.st_mtim.tv_nsec;
+#elif defined(__APPLE__)
+        stat.m_mtime_ns += info.st_mtimespec.tv_nsec;
+#endif
+    }
+    
+    /**
+     * @brief Stats and hashes of source files and dependencies seen during
+     * this build, keyed by absolute path. Replaces the "stat-cache" in 
+     * intermediate.data so that files no longer used drop out of it.
+     */
+    Json::Value m_json_stat_cache;
+    
+    std::string stat_cache_key(const boost::filesystem::path& file) {
+        return boost::filesystem::absolute(file).string();
+    }
+    
+    /**
+     * @brief Makes sure every given file has an entry in m_json_stat_cache.
+     * A file is only read if its size, modification time or inode differ
+     * from when it was last hashed, or if it was never hashed before. Files
+     * which do need reading are hashed in parallel. Files which cannot be
+     * hashed, such as missing ones, are left out.
+     */
+    void hash_files(const std::vector<boost::filesystem::path>& files) {
+        struct Pending_Hash {
+            boost::filesystem::path m_file;
+            File_Stat m_stat;
+            Hash128 m_hash;
+            bool m_failed = false;
+        };
+        std::map<std::string, Pending_Hash> pending;
+        
+        const Json::Value& json_interm = m_json_interm;
+        for (const boost::filesystem::path& file : files) {
+            std::string key = stat_cache_key(file);
+            
+            // Multiple resources can share the same file
+            if (m_json_stat_cache.isMember(key) || pending.count(key) > 0) {
+                continue;
+            }
+            
+            File_Stat stat;
+            try {
+                stat_file(file, stat);
+            } catch (std::runtime_error& e) {
+                Logger::log()->warn("Failed to calculate hashes: %v", 
+                        e.what());
+                continue;
+            }
+            
+            const Json::Value& json_prev = json_interm["stat-cache"][key];
+            Hash128 prev_hash;
+            if (json_prev.isObject()
+                    && json_prev["size"].asUInt64() == stat.m_size
+                    && json_prev["mtime"].asInt64() == stat.m_mtime_ns
+                    && json_prev["inode"].asUInt64() == stat.m_inode
+                    && Hash128::from_string(
+                            json_prev["hash"].asString(), prev_hash)) {
+                m_json_stat_cache[key] = json_prev;
+                continue;
+            }
+            
+            Pending_Hash& hash = pending[key];
+            hash.m_file = file;
+            hash.m_stat = stat;
+        }
+        
+        Scheduler scheduler(n_num_jobs);
+        for (auto& pair : pending) {
+            Pending_Hash& hash = pair.second;
+            scheduler.add_job([&hash]() {
+                Trace_Span span("hash", hash.m_file.filename().string());
+                span.add_arg("bytes", hash.m_stat.m_size);
+                try {
+                    hash.m_hash = hash_file(hash.m_file);
+                } catch (std::runtime_error& e) {
+                    hash.m_failed = true;
+                    Logger::log()->warn("Failed to calculate hashes: %v", 
+                            e.what());
+                }
+            }, hash.m_stat.m_size);
+        }
+        scheduler.run();
+        
+        for (auto& pair : pending) {
+            Pending_Hash& hash = pair.second;
+            if (hash.m_failed) {
+                continue;
+            }
+            Json::Value& json_stat = m_json_stat_cache[pair.first];
+            json_stat["size"] = (Json::UInt64) hash.m_stat.m_size;
+            json_stat["mtime"] = (Json::Int64) hash.m_stat.m_mtime_ns;
+            json_stat["inode"] = (Json::UInt64) hash.m_stat.m_inode;
+            json_stat["hash"] = hash.m_hash.to_string();
+        }
+    }
+    
+    /**
+     * @brief Adds a file whose hash is already known, such as a fresh copy
+     * of another file, to m_json_stat_cache without reading it
+     */
+    void cache_file_hash(const boost::filesystem::path& file, 
+            const Hash128& hash) {
+        File_Stat stat;
+        stat_file(file, stat);
+        Json::Value& json_stat = m_json_stat_cache[stat_cache_key(file)];
+        json_stat["size"] = (Json::UInt64) stat.m_size;
+        json_stat["mtime"] = (Json::Int64) stat.m_mtime_ns;
+        json_stat["inode"] = (Json::UInt64) stat.m_inode;
+        json_stat["hash"] = hash.to_string();
+    }
+    
+    /**
+     * @brief Looks up a file hashed by hash_files()
+     * @return false if the file could not be hashed
+     */
+    bool find_file_hash(const boost::filesystem::path& file, Hash128& hash, 
+            uint64_t* size = nullptr) {
+        const Json::Value& json_stat_cache = m_json_stat_cache;
+        const Json::Value& json_stat = json_stat_cache[stat_cache_key(file)];
+        if (!json_stat.isObject()) {
+            return false;
+        }
+        if (size) {
+            *size = json_stat["size"].asUInt64();
+        }
+        return Hash128::from_string(json_stat["hash"].asString(), hash);
     }
     
     /**
-     * @brief Not a perfect hash (For some inputs, equal jsons does not imply 
-     * equal hashes and unequal hashes does not imply unequal jsons) However,
-     * for most cases this works good enough.
-     * @param val
-     * @param hash
+     * @brief checksum_data() of a file's contents, from the stat cache if
+     * hash_files() has seen it
      */
-    void hash_json(const Json::Value& val, uint32_t& hash) {
-        std::string string_json = val.toStyledString();
-        MurmurHash3_x86_32(string_json.c_str(), string_json.size(), 0xdaff0d11,
-                &hash);
+    uint64_t find_checksum(const boost::filesystem::path& file) {
+        Hash128 hash;
+        if (!find_file_hash(file, hash)) {
+            hash = hash_file(file);
+        }
+        return hash.m_low;
     }
     
-    std::string generate_interm_code(const Object& object) {
+    /**
+     * @brief Hashes the compact serialization of a json value. Object keys 
+     * are always written in sorted order, so key order and whitespace in the
+     * declaration files do not matter. (Equal numbers written differently,
+     * such as 1 and 1.0, may still give different hashes.)
+     */
+    Hash128 hash_json(const Json::Value& val) {
+        Json::FastWriter writer;
+        std::string string_json = writer.write(val);
+        return hash_data(string_json.data(), string_json.size());
+    }
+    
+    /**
+     * @brief The key under which the converted form of an object is cached.
+     * Deliberately does not include the object's name or location, so the 
+     * same conversion is shared by every resource, package and working copy
+     * that asks for it. Covers the contents of the object's dependencies,
+     * which must already have been hashed.
+     */
+    Hash128 generate_cache_key(const Object& object) {
+        uint32_t version = 0;
+        auto version_iter = n_converter_versions.find(object.m_type);
+        if (version_iter != n_converter_versions.end()) {
+            version = version_iter->second;
+        }
+        
         std::stringstream sss;
-        sss << object.m_name;
-        sss << "|||";
         sss << object.m_type;
         sss << "|||";
+        sss << version;
+        sss << "|||";
         sss << object.m_src_hash;
         sss << "|||";
         sss << object.m_params_hash;
-        return sss.str();
+        for (const boost::filesystem::path& dependency 
+                : object.m_dependencies) {
+            // A missing dependency hashes as zero, which is fine: if the
+            // converter still succeeds, its output is valid until it appears
+            Hash128 dep_hash;
+            find_file_hash(dependency, dep_hash);
+            sss << "|||";
+            sss << dep_hash;
+        }
+        std::string code = sss.str();
+        return hash_data(code.data(), code.size());
     }
     
     Json::Value m_json_interm;
     boost::filesystem::path m_interm_file;
     void use_previous_intermediates() {
+        if (m_conf.m_cache_dir.empty()) {
+            m_conf.m_cache_dir = m_conf.m_interm_dir / "cache";
+        }
+        
         if (boost::filesystem::exists(m_conf.m_interm_dir)) {
             if (n_reset_interm) {
                 clean_directory(m_conf.m_interm_dir);
@@ -545,67 +979,180 @@ private:
             boost::filesystem::create_directories(m_conf.m_interm_dir);
         }
         
-        m_interm_file = m_conf.m_interm_dir / "intermediate.data";
-        if (!boost::filesystem::exists(m_interm_file)) {
-            m_json_interm["next-idx"] = 0;
+        // The default cache went with the intermediate folder above. One
+        // elsewhere may be shared with other working copies, which may be
+        // building right now, so only --purge-cache deletes it.
+        if (boost::filesystem::exists(m_conf.m_cache_dir)) {
+            if (n_purge_cache) {
+                clean_directory(m_conf.m_cache_dir);
+            }
         } else {
+            boost::filesystem::create_directories(m_conf.m_cache_dir);
+        }
+        Logger::log()->info("Cache dir: %v", m_conf.m_cache_dir);
+        
+        m_interm_file = m_conf.m_interm_dir / "intermediate.data";
+        if (boost::filesystem::exists(m_interm_file)) {
             m_json_interm = readJsonFile(m_interm_file.string());
         }
-
+        
+        // Left over from before the cache was content-addressed
+        m_json_interm.removeMember("metadata");
+        m_json_interm.removeMember("next-idx");
+        
+        check_cached_conversions();
+    }
+    
+    boost::filesystem::path get_cache_file(const Hash128& cache_key) {
+        std::string key_string = cache_key.to_string();
+        return m_conf.m_cache_dir / key_string.substr(0, 2) / key_string;
+    }
+    
+    void check_cached_conversions() {
         Logger::log()->info("Checking for pre-compiled data...");
-
-        Json::Value& json_metadatas = m_json_interm["metadata"];
-        Json::Value& json_next_idx = m_json_interm["next-idx"];
-        uint64_t next_idx = json_next_idx.asUInt64();
+        
+        // Files other than the source which each object's converter read 
+        // last time it ran. Assume they are still the same files; if not,
+        // the source or params must have changed too, so the cache key will 
+        // differ anyway.
+        const Json::Value& json_interm = m_json_interm;
+        const Json::Value& json_deps = json_interm["dependencies"];
+        
+        std::vector<boost::filesystem::path> files;
         for (Object& object : m_objects) {
-            try {
-                hash_file(object.m_src_file, object.m_src_hash);
-                hash_json(object.m_params, object.m_params_hash);
-            } catch (std::runtime_error& e) {
-                Logger::log()->warn("Failed to calculate hashes: %v", e.what());
+            object.m_dependencies.clear();
+            for (const Json::Value& json_dep : json_deps[object.m_name]) {
+                object.m_dependencies.emplace_back(json_dep.asString());
             }
+            files.push_back(object.m_src_file);
+            files.insert(files.end(), object.m_dependencies.begin(), 
+                    object.m_dependencies.end());
+        }
+        m_json_stat_cache = Json::Value();
+        hash_files(files);
+        
+        for (Object& object : m_objects) {
+            object.m_skip_retrans = false;
+            find_file_hash(object.m_src_file, object.m_src_hash, 
+                    &object.m_src_size);
+            object.m_params_hash = hash_json(object.m_params);
             
             /*
-             * If a pre-compiled file exists with exactly the same:
+             * If the cache already has an entry for exactly the same:
+             *  Resource type and converter version
              *  Src file hash
-             *  Resource type
              *  Compilation params hash
-             *  Compilation params
+             *  Dependency hashes
              *
              * Then simply copy the data into the output folder rather 
              * than translate it again. (Therefore remove that object 
              * from the list of objects to translate.)
              */
             
-            std::string interm_code = generate_interm_code(object);
-            Json::Value& json_metadata = json_metadatas[interm_code.c_str()];
+            boost::filesystem::path cache_file = 
+                    get_cache_file(generate_cache_key(object));
             
-            if (!object.m_force_retrans && !json_metadata.isNull()
-                    && equivalentJson(
-                            object.m_params, json_metadata["params"])) {
+            if (!object.m_force_retrans 
+                    && boost::filesystem::exists(cache_file)) {
                 Logger::log()->verbose(2, "\tCopy: %v", object.m_name);
-                
                 object.m_skip_retrans = true;
-                object.m_interm_file = m_conf.m_interm_dir 
-                        / (json_metadata["file"].asString());
-                
+                object.m_interm_file = cache_file;
             } else {
-                if (object.m_force_retrans) {
-                    boost::filesystem::path old_interm = m_conf.m_interm_dir 
-                            / (json_metadata["file"].asString());
-                    boost::filesystem::remove(old_interm);
-                }
-                
-                std::stringstream sss;
-                sss << next_idx << ".r";
-                
-                object.m_interm_file = m_conf.m_interm_dir / sss.str();
-                
-                ++next_idx;
+                // The real cache key is only known once the converter has
+                // reported which other files it read
+                object.m_interm_file = m_conf.m_cache_dir 
+                        / boost::filesystem::unique_path(
+                                "%%%%-%%%%-%%%%-%%%%.partial");
+            }
+        }
+    }
+    
+    /**
+     * @brief Moves a newly converted object into the cache under its key,
+     * now that its dependencies are known. Call hash_files() on the 
+     * dependencies first.
+     */
+    void store_conversion(Object& object) {
+        boost::filesystem::path cache_file = 
+                get_cache_file(generate_cache_key(object));
+        boost::filesystem::create_directories(cache_file.parent_path());
+        boost::filesystem::rename(object.m_interm_file, cache_file);
+        object.m_interm_file = cache_file;
+    }
+    
+    /**
+     * @brief Estimated time in nanoseconds to translate an object, used to
+     * start the most expensive conversions first. Based on how fast this
+     * object's converter got through its source files in previous runs.
+     */
+    uint64_t estimate_translate_cost(const Object& object) {
+        double ns_per_byte = 1.0;
+        const Json::Value& json_interm = m_json_interm;
+        const Json::Value& json_cost = 
+                json_interm["converter-costs"][object.m_type];
+        if (json_cost.isObject()) {
+            ns_per_byte = json_cost["ns-per-byte"].asDouble();
+        }
+        return (uint64_t) (ns_per_byte * (object.m_src_size + 1));
+    }
+    
+    /**
+     * @brief Updates the per-converter cost estimates stored in
+     * intermediate.data with the timings of the conversions just made,
+     * taken from each object's m_stats.
+     * @param translate_failed Non-zero for each object in m_objects whose
+     * conversion failed, which are left out along with skipped objects
+     */
+    void record_translate_costs(const std::vector<uint8_t>& translate_failed) {
+        struct Totals {
+            uint64_t m_bytes = 0;
+            uint64_t m_nanos = 0;
+        };
+        std::map<OType, Totals> totals;
+        for (std::size_t idx = 0; idx < m_objects.size(); ++idx) {
+            const Object& object = m_objects[idx];
+            if (object.m_skip_retrans || translate_failed[idx]) {
+                continue;
             }
+            Totals& total = totals[object.m_type];
+            total.m_bytes += object.m_src_size + 1;
+            total.m_nanos += object.m_stats.m_total_ns;
         }
         
-        json_next_idx = next_idx;
+        Json::Value& json_costs = m_json_interm["converter-costs"];
+        for (auto& pair : totals) {
+            double ns_per_byte = 
+                    ((double) pair.second.m_nanos) / pair.second.m_bytes;
+            
+            // Average with the previous estimate to smooth out noisy runs
+            Json::Value& json_cost = json_costs[pair.first];
+            if (json_cost.isObject()) {
+                ns_per_byte = 
+                        (ns_per_byte + json_cost["ns-per-byte"].asDouble()) / 2;
+            }
+            json_cost["ns-per-byte"] = ns_per_byte;
+        }
+    }
+    
+    /**
+     * @brief Estimated peak memory in bytes used while translating an object
+     */
+    uint64_t estimate_translate_memory(const Object& object) {
+        auto pair_ptr = n_memory_estimators.find(object.m_type);
+        if (pair_ptr == n_memory_estimators.end()) {
+            return object.m_src_size;
+        }
+        
+        Convert_Args args;
+        args.fromFile = object.m_src_file;
+        args.outputFile = object.m_interm_file;
+        args.modifyFilename = !m_conf.m_obfuscate;
+        args.params = object.m_params;
+        try {
+            return pair_ptr->second(args);
+        } catch (std::runtime_error& e) {
+            return object.m_src_size;
+        }
     }
     
     void process_all_resources() {
@@ -615,6 +1162,7 @@ private:
         uint32_t num_skips = 0;
         uint32_t num_converts = 0;
         uint32_t num_fails = 0;
+        uint32_t num_published[4] = {0, 0, 0, 0};
 
         // Append the file provided by user
         Json::Value json_output_pkg;
@@ -622,72 +1170,676 @@ private:
         json_output_pkg["userdata"] = m_package_json;
         Json::Value& json_res_list = json_output_pkg["resources"];
 
-        Json::Value& json_interm_metadatas = m_json_interm["metadata"];
-        for (Object& object : m_objects) {
-
+        // Converters only touch their own object's files, so they can all
+        // run at once. Everything shared (intermediate.data, data.package) is
+        // written afterwards on this thread in m_objects order, which keeps
+        // the output identical to a serial run.
+        auto start = std::chrono::steady_clock::now();
+        std::vector<uint8_t> translate_failed(m_objects.size(), 0);
+        Scheduler scheduler(n_num_jobs, n_memory_budget);
+        for (std::size_t idx = 0; idx < m_objects.size(); ++idx) {
+            Object& object = m_objects[idx];
             if (object.m_skip_retrans) {
-                ++num_skips;
+                continue;
             }
-            else {
+            uint8_t& failed = translate_failed[idx];
+            scheduler.add_job([this, &object, &failed]() {
                 Logger::log()->info("%v [%v]", object.m_name, object.m_type);
+                Trace_Span span("convert", object.m_name);
+                span.add_arg("type", object.m_type);
                 try {
                     translateData(object, !m_conf.m_obfuscate);
+                    span.add_arg("input-bytes", object.m_stats.m_input_bytes);
+                    span.add_arg("output-bytes", 
+                            object.m_stats.m_output_bytes);
                 }
-                catch (std::runtime_error e) {
-                    ++num_fails;
+                catch (std::runtime_error& e) {
+                    failed = 1;
                     Logger::log()->warn("%v failed to translate: %v", 
                             object.m_name, e.what());
-                    continue;
                 }
+            }, estimate_translate_cost(object), 
+                    n_memory_budget ? estimate_translate_memory(object) : 0);
+        }
+        {
+            Trace_Span span("phase", "convert");
+            scheduler.run();
+        }
+        uint64_t convert_ns = 
+                elapsed_nanos(start, std::chrono::steady_clock::now());
+        record_translate_costs(translate_failed);
+        
+        std::vector<boost::filesystem::path> dependencies;
+        for (std::size_t idx = 0; idx < m_objects.size(); ++idx) {
+            Object& object = m_objects[idx];
+            if (!object.m_skip_retrans && !translate_failed[idx]) {
+                dependencies.insert(dependencies.end(), 
+                        object.m_dependencies.begin(), 
+                        object.m_dependencies.end());
+            }
+        }
+        {
+            Trace_Span span("phase", "hash dependencies");
+            hash_files(dependencies);
+        }
+        
+        std::vector<boost::filesystem::path> outputs;
+        for (std::size_t idx = 0; idx < m_objects.size(); ++idx) {
+            Object& object = m_objects[idx];
+            if (object.m_skip_retrans) {
+                ++num_skips;
+            }
+            else if (translate_failed[idx]) {
+                ++num_fails;
+                continue;
+            }
+            else {
+                store_conversion(object);
                 ++num_converts;
             }
+            outputs.push_back(object.m_interm_file);
+            
+            // Published copies are only replaced if their contents differ
+            if (!m_conf.m_pack 
+                    && boost::filesystem::exists(object.m_dest_file)) {
+                outputs.push_back(object.m_dest_file);
+            }
+        }
+        
+        // Cached conversions never change, so after the first time these
+        // hashes come straight from the stat cache
+        {
+            Trace_Span span("phase", "hash outputs");
+            hash_files(outputs);
+        }
+        
+        Json::Value& json_deps = m_json_interm["dependencies"];
+        json_deps = Json::Value();
+        
+        // Archive name to its entries
+        std::map<std::string, std::vector<Pack_Entry> > pack_groups;
+        std::vector<Index_Entry> index_entries;
+        std::vector<uint64_t> load_orders;
+        if (m_conf.m_pack) {
+            load_orders = find_load_orders();
+        }
+        
+        // Objects which converted to the same bytes are only stored once.
+        // Maps to an index in pack_groups or m_objects. Archives may be
+        // mounted on their own, so bytes are only shared within one.
+        std::map<std::pair<std::string, Hash128>, std::size_t> 
+                first_with_content;
+        uint32_t num_duplicates = 0;
+        uint64_t duplicate_size = 0;
+
+        for (std::size_t idx = 0; idx < m_objects.size(); ++idx) {
+            Object& object = m_objects[idx];
+            if (!object.m_skip_retrans && translate_failed[idx]) {
+                continue;
+            }
+            
+            std::string group;
+            if (m_conf.m_pack) {
+                group = object.m_group.empty() ? "data" : object.m_group;
+            }
+            Hash128 content;
+            bool have_content = find_file_hash(object.m_interm_file, content);
+            auto original = first_with_content.end();
+            if (have_content) {
+                original = first_with_content.find({group, content});
+            }
             
-            std::string interm_code = generate_interm_code(object);
-            Json::Value& json_interm_metadata = 
-                    json_interm_metadatas[interm_code.c_str()];
-            json_interm_metadata["params"] = object.m_params;
-            json_interm_metadata["file"] = 
-                    object.m_interm_file.filename().string().c_str();
+            if (!object.m_dependencies.empty()) {
+                Json::Value& json_obj_deps = json_deps[object.m_name];
+                for (const boost::filesystem::path& dependency 
+                        : object.m_dependencies) {
+                    json_obj_deps.append(stat_cache_key(dependency));
+                }
+            }
             
+            if (m_conf.m_pack) {
+                std::vector<Pack_Entry>& pack_entries = pack_groups[group];
+                pack_entries.emplace_back();
+                Pack_Entry& entry = pack_entries.back();
+                entry.m_name = object.m_name;
+                entry.m_type = object.m_type;
+                entry.m_file = object.m_interm_file;
+                entry.m_load_order = load_orders[idx];
+                if (original != first_with_content.end()) {
+                    entry.m_same_as = original->second;
+                    ++num_duplicates;
+                    duplicate_size += 
+                            boost::filesystem::file_size(entry.m_file);
+                } else if (have_content) {
+                    first_with_content[{group, content}] = 
+                            pack_entries.size() - 1;
+                }
+                continue;
+            }
             
-
-            if (boost::filesystem::exists(object.m_dest_file)) {
-                boost::filesystem::remove(object.m_dest_file);
+            // Where the bytes actually end up. Only for this build, since a
+            // duplicate can diverge from its original later in watch mode.
+            boost::filesystem::path published_file = object.m_dest_file;
+            if (original != first_with_content.end()) {
+                const Object& original_obj = m_objects[original->second];
+                published_file = original_obj.m_dest_file;
+                object.m_dest_size = original_obj.m_dest_size;
+                ++num_duplicates;
+                duplicate_size += object.m_dest_size;
+                
+                // Left over from a build where it was not a duplicate yet
+                boost::system::error_code ignored;
+                boost::filesystem::remove(object.m_dest_file, ignored);
+            } else {
+                Hash128 published_content;
+                bool same_content = have_content
+                        && find_file_hash(object.m_dest_file, 
+                                published_content)
+                        && published_content == content;
+                uint64_t dest_size;
+                Publish_Method method = publish_file(object.m_interm_file, 
+                        object.m_dest_file, dest_size, same_content);
+                ++num_published[(std::size_t) method];
+                if (have_content && method != Publish_Method::UNCHANGED) {
+                    cache_file_hash(object.m_dest_file, content);
+                }
+                object.m_dest_size = dest_size;
+                if (have_content) {
+                    first_with_content[{group, content}] = idx;
+                }
             }
-            boost::filesystem::copy(object.m_interm_file, 
-                    object.m_dest_file);
-            std::ifstream sizeTest(
-                    object.m_dest_file.string().c_str(), 
-                    std::ios::binary | std::ios::ate);
-            object.m_dest_size = sizeTest.tellg();
-            //
+            
             Json::Value& json_obj_def = json_res_list[object.m_name];
             json_obj_def["type"] = object.m_type;
-            json_obj_def["file"] = object.m_dest_file.filename().string().c_str();
+            json_obj_def["file"] = published_file.filename().string().c_str();
             json_obj_def["size"] = object.m_dest_size;
+            
+            // The published file has the same bytes as the cached one
+            uint64_t checksum = have_content ? content.m_low 
+                    : find_checksum(object.m_interm_file);
+            json_obj_def["checksum"] = checksum_string(checksum);
+            
+            index_entries.emplace_back();
+            Index_Entry& index_entry = index_entries.back();
+            index_entry.m_name = object.m_name;
+            index_entry.m_type = object.m_type;
+            index_entry.m_file = published_file.filename().string();
+            index_entry.m_size = object.m_dest_size;
+            index_entry.m_raw_size = object.m_dest_size;
+            index_entry.m_checksum = checksum;
 
-            totalSize += object.m_dest_size;
-
+            if (original == first_with_content.end()) {
+                totalSize += object.m_dest_size;
+            }
         }
         Logger::log()->info("%v file(s) already built", num_skips);
         Logger::log()->info("%v file(s) translated", num_converts);
         Logger::log()->info("%v file(s) failed", num_fails);
+        Logger::log()->info("%v file(s) stored once with identical files, "
+                "saving %v bytes", num_duplicates, duplicate_size);
+        if (m_conf.m_pack) {
+            totalSize = export_pack(pack_groups, json_output_pkg, 
+                    index_entries);
+        } else {
+            Logger::log()->info("%v file(s) published (%v unchanged, "
+                    "%v reflinked, %v hardlinked, %v copied)", 
+                    num_skips + num_converts - num_duplicates,
+                    num_published[(std::size_t) Publish_Method::UNCHANGED],
+                    num_published[(std::size_t) Publish_Method::REFLINK],
+                    num_published[(std::size_t) Publish_Method::HARDLINK],
+                    num_published[(std::size_t) Publish_Method::COPY]);
+        }
+        remove_stale_outputs(json_output_pkg);
 
+        m_json_interm["stat-cache"] = m_json_stat_cache;
         Logger::log()->info("Exporting intermediate.data... ");
         writeJsonFile(m_interm_file.string(), m_json_interm, true);
         Logger::log()->info("Done!");
 
+        Logger::log()->info("Exporting data.index... ");
+        boost::filesystem::path index_file = 
+                m_conf.m_output_dir / "data.index";
+        boost::filesystem::path partial_index = index_file;
+        partial_index += ".partial";
+        write_index(partial_index, index_entries, m_conf.m_merkle_root,
+                packed_format_version());
+        boost::filesystem::rename(partial_index, index_file);
+        Logger::log()->info("Done!");
+        
+        std::vector<std::string> names;
+        for (const Index_Entry& entry : index_entries) {
+            names.push_back(entry.m_name);
+        }
+        // Only code that is built against this data needs it, the loader
+        // does not, so it stays out of the output unless asked for
+        boost::filesystem::path id_header = m_conf.m_id_header;
+        if (id_header.empty()) {
+            id_header = m_conf.m_interm_dir / "ResourceIds.hpp";
+        }
+        if (write_id_header(id_header, names, m_conf.m_id_namespace)) {
+            Logger::log()->info("Exported %v", id_header);
+        }
+
         Logger::log()->info("Exporting data.package... ");
 
+        json_output_pkg["index"] = index_file.filename().string();
         Json::Value& metricsData = json_output_pkg["metrics"];
         metricsData["size"] = (Json::UInt64) totalSize;
-        writeJsonFile((m_conf.m_output_dir / "data.package").string(), 
-                json_output_pkg, true);
+        metricsData["deduplicated-size"] = (Json::UInt64) duplicate_size;
+        
+        // Replace rather than overwrite, so that a running game reloading
+        // the package in watch mode never reads a half-written file
+        boost::filesystem::path package_file = 
+                m_conf.m_output_dir / "data.package";
+        boost::filesystem::path partial_file = package_file;
+        partial_file += ".partial";
+        writeJsonFile(partial_file.string(), json_output_pkg, true);
+        boost::filesystem::rename(partial_file, package_file);
         Logger::log()->info("Done!");
+        
+        write_build_report(translate_failed, scheduler.get_num_workers(), 
+                convert_ns, 
+                elapsed_nanos(start, std::chrono::steady_clock::now()));
+    }
+    
+    /**
+     * @brief Where each object goes in the archive. Resources in the access
+     * trace come first, in the order they were first used. The rest follow
+     * by load group, in the configured order and then in order of first
+     * appearance. Resources without a group go last unless "*" is one of the
+     * configured groups.
+     */
+    std::vector<uint64_t> find_load_orders() {
+        std::map<std::string, uint64_t> traced;
+        if (!m_conf.m_access_trace.empty()) {
+            std::ifstream input(m_conf.m_access_trace.string().c_str());
+            if (input.fail()) {
+                std::stringstream sss;
+                sss << "Cannot open access trace: "
+                    << m_conf.m_access_trace;
+                throw std::runtime_error(sss.str());
+            }
+            std::string line;
+            while (std::getline(input, line)) {
+                if (!line.empty() && line.back() == '\r') {
+                    line.pop_back();
+                }
+                if (!line.empty() && traced.find(line) == traced.end()) {
+                    uint64_t position = traced.size();
+                    traced[line] = position;
+                }
+            }
+        }
+        
+        std::map<std::string, uint64_t> groups;
+        auto add_group = [&groups](const std::string& group) {
+            if (groups.find(group) == groups.end()) {
+                uint64_t position = groups.size();
+                groups[group] = position;
+            }
+        };
+        for (const std::string& group : m_conf.m_load_groups) {
+            add_group(group);
+        }
+        for (const Object& object : m_objects) {
+            if (!object.m_load_group.empty()) {
+                add_group(object.m_load_group);
+            }
+        }
+        add_group("*");
+        
+        uint32_t num_traced = 0;
+        std::vector<uint64_t> retval;
+        for (const Object& object : m_objects) {
+            auto iter = traced.find(object.m_name);
+            if (iter != traced.end()) {
+                retval.push_back(iter->second);
+                ++num_traced;
+                continue;
+            }
+            const std::string& group = object.m_load_group.empty() 
+                    ? "*" : object.m_load_group;
+            retval.push_back(traced.size() + groups[group]);
+        }
+        if (!m_conf.m_access_trace.empty()) {
+            Logger::log()->info("%v resource(s) ordered by access trace", 
+                    num_traced);
+        }
+        return retval;
+    }
+    
+    /**
+     * @brief Writes every converted object into one archive per group, each
+     * split into volumes if configured, and lists where each object is in
+     * the package file.
+     * @return Total size of the archives
+     */
+    uint64_t export_pack(
+            std::map<std::string, std::vector<Pack_Entry> >& groups, 
+            Json::Value& json_output_pkg, 
+            std::vector<Index_Entry>& index_entries) {
+        Trace_Span span("phase", "export_pack");
+        uint64_t total_size = 0;
+        Json::Value& json_packs = json_output_pkg["packs"];
+        for (auto& group : groups) {
+            std::vector<Pack_Entry>& entries = group.second;
+            order_pack(entries);
+            compress_pack_entries(entries);
+            
+            // Compressed copies are only hashed the first time
+            std::vector<boost::filesystem::path> files;
+            for (const Pack_Entry& entry : entries) {
+                files.push_back(entry.m_file);
+            }
+            hash_files(files);
+            
+            std::vector<std::vector<Pack_Entry> > volumes = 
+                    split_pack(entries, m_conf.m_pack_max_size);
+            
+            // The first volume keeps the plain name, so that an archive
+            // which fits in one volume is named the same either way
+            for (std::size_t idx = 0; idx < volumes.size(); ++idx) {
+                std::stringstream sss;
+                sss << group.first;
+                if (idx > 0) {
+                    sss << '.' << idx;
+                }
+                sss << ".pack";
+                json_packs[group.first].append(sss.str());
+                total_size += export_volume(volumes[idx], sss.str(), 
+                        json_output_pkg, index_entries);
+            }
+        }
+        return total_size;
+    }
+    
+    /**
+     * @brief Deletes archives and loose files left in the output directory by
+     * earlier builds with other settings (--max-pack, groups, --pack), so
+     * that they are not mistaken for part of this build.
+     */
+    void remove_stale_outputs(const Json::Value& json_output_pkg) {
+        std::set<std::string> written;
+        const Json::Value& json_packs = json_output_pkg["packs"];
+        for (auto iter = json_packs.begin(); iter != json_packs.end(); 
+                ++iter) {
+            for (const Json::Value& json_file : *iter) {
+                written.insert(json_file.asString());
+            }
+        }
+        
+        boost::system::error_code ignored;
+        for (const Object& object : m_objects) {
+            std::string file_name = object.m_dest_file.filename().string();
+            if (!m_conf.m_pack) {
+                written.insert(file_name);
+            } else if (written.find(file_name) == written.end()) {
+                boost::filesystem::remove(object.m_dest_file, ignored);
+            }
+        }
+        
+        std::vector<boost::filesystem::path> stale;
+        boost::filesystem::directory_iterator end;
+        for (boost::filesystem::directory_iterator iter(m_conf.m_output_dir);
+                iter != end; ++iter) {
+            const boost::filesystem::path& file = iter->path();
+            if (file.extension() == ".pack" 
+                    && boost::filesystem::is_regular_file(file)
+                    && written.find(file.filename().string()) 
+                            == written.end()) {
+                stale.push_back(file);
+            }
+        }
+        for (const boost::filesystem::path& file : stale) {
+            Logger::log()->info("Removing stale archive %v", file);
+            boost::filesystem::remove(file, ignored);
+        }
+    }
+    
+    /**
+     * @brief Writes a single archive. It is only rewritten if its contents
+     * would change.
+     * @return Size of the archive
+     */
+    uint64_t export_volume(std::vector<Pack_Entry>& entries, 
+            const std::string& file_name, Json::Value& json_output_pkg, 
+            std::vector<Index_Entry>& index_entries) {
+        uint64_t pack_size = layout_pack(entries);
+        
+        // Cached conversions are named after their cache key, so this
+        // changes whenever any entry's contents or place in the archive do
+        std::stringstream sss;
+        for (const Pack_Entry& entry : entries) {
+            sss << entry.m_name << '\0'
+                << entry.m_type << '\0'
+                << entry.m_file.filename().string() << '\0'
+                << entry.m_offset << '\0';
+        }
+        std::string key_data = sss.str();
+        Hash128 build_key = hash_data(key_data.data(), key_data.size());
+        
+        boost::filesystem::path pack_file = m_conf.m_output_dir / file_name;
+        Hash128 old_key;
+        if (read_pack_build_key(pack_file, old_key) 
+                && old_key == build_key
+                && boost::filesystem::file_size(pack_file) == pack_size) {
+            Logger::log()->info("%v is unchanged", file_name);
+        } else {
+            Logger::log()->info("Exporting %v... ", file_name);
+            boost::filesystem::path partial_file = pack_file;
+            partial_file += ".partial";
+            try {
+                write_pack(partial_file, entries, build_key);
+            } catch (...) {
+                boost::system::error_code ignored;
+                boost::filesystem::remove(partial_file, ignored);
+                throw;
+            }
+            boost::filesystem::rename(partial_file, pack_file);
+            Logger::log()->info("Done!");
+        }
+        
+        Json::Value& json_res_list = json_output_pkg["resources"];
+        for (const Pack_Entry& entry : entries) {
+            uint64_t checksum = find_checksum(entry.m_file);
+            Json::Value& json_obj_def = json_res_list[entry.m_name];
+            json_obj_def["type"] = entry.m_type;
+            json_obj_def["file"] = file_name;
+            json_obj_def["offset"] = (Json::UInt64) entry.m_offset;
+            json_obj_def["size"] = (Json::UInt64) entry.m_size;
+            if (entry.m_codec != Codec::NONE) {
+                json_obj_def["codec"] = codec_name(entry.m_codec);
+                json_obj_def["raw-size"] = (Json::UInt64) entry.m_raw_size;
+            }
+            json_obj_def["checksum"] = checksum_string(checksum);
+            
+            index_entries.emplace_back();
+            Index_Entry& index_entry = index_entries.back();
+            index_entry.m_name = entry.m_name;
+            index_entry.m_type = entry.m_type;
+            index_entry.m_file = file_name;
+            index_entry.m_offset = entry.m_offset;
+            index_entry.m_size = entry.m_size;
+            index_entry.m_raw_size = entry.m_raw_size;
+            index_entry.m_codec = entry.m_codec;
+            index_entry.m_checksum = checksum;
+        }
+        return pack_size;
+    }
+    
+    /**
+     * @brief Switches entries over to compressed copies of their files where
+     * configured and worthwhile. Compressed copies are kept in the cache next
+     * to the uncompressed file, so each is only compressed once.
+     */
+    void compress_pack_entries(std::vector<Pack_Entry>& entries) {
+        Trace_Span span("phase", "compress_pack_entries");
+        std::vector<boost::filesystem::path> compressed_files(entries.size());
+        std::vector<Codec> codecs(entries.size(), Codec::NONE);
+        Scheduler scheduler(n_num_jobs);
+        for (std::size_t idx = 0; idx < entries.size(); ++idx) {
+            const Pack_Entry& entry = entries[idx];
+            Codec codec = find_pack_codec(entry.m_type);
+            if (codec == Codec::NONE || !codec_available(codec)
+                    || entry.m_same_as >= 0) {
+                continue;
+            }
+            boost::filesystem::path& compressed = compressed_files[idx];
+            compressed = entry.m_file;
+            compressed += ".";
+            compressed += codec_name(codec);
+            codecs[idx] = codec;
+            if (boost::filesystem::exists(compressed)) {
+                continue;
+            }
+            scheduler.add_job([this, &entry, &compressed, codec]() {
+                Trace_Span span("compress", entry.m_name);
+                span.add_arg("codec", codec_name(codec));
+                boost::filesystem::path partial_file = m_conf.m_cache_dir 
+                        / boost::filesystem::unique_path(
+                                "%%%%-%%%%-%%%%-%%%%.partial");
+                try {
+                    if (compress_file(entry.m_file, partial_file, codec)) {
+                        boost::filesystem::rename(partial_file, compressed);
+                    }
+                } catch (std::runtime_error& e) {
+                    Logger::log()->warn("%v failed to compress: %v", 
+                            entry.m_name, e.what());
+                }
+                boost::system::error_code ignored;
+                boost::filesystem::remove(partial_file, ignored);
+            }, boost::filesystem::file_size(entry.m_file));
+        }
+        scheduler.run();
+        
+        for (std::size_t idx = 0; idx < entries.size(); ++idx) {
+            Pack_Entry& entry = entries[idx];
+            const boost::filesystem::path& compressed = compressed_files[idx];
+            if (codecs[idx] == Codec::NONE 
+                    || !boost::filesystem::exists(compressed)) {
+                continue;
+            }
+            uint64_t raw_size = boost::filesystem::file_size(entry.m_file);
+            uint64_t size = boost::filesystem::file_size(compressed);
+            if (size > raw_size * (1.0 - m_conf.m_pack_min_savings)) {
+                continue;
+            }
+            entry.m_file = compressed;
+            entry.m_codec = codecs[idx];
+            entry.m_raw_size = raw_size;
+        }
+    }
+    
+    /**
+     * @brief Writes build.report next to data.package, summarizing where
+     * the time and memory of this run went for each converter type. Meant to
+     * be compared between builds to catch regressions.
+     * 
+     * Peak RSS is per-process, so with more than one job it also includes
+     * whatever else was being converted at the same time.
+     */
+    void write_build_report(const std::vector<uint8_t>& translate_failed, 
+            uint32_t num_workers, uint64_t convert_ns, uint64_t total_ns) {
+        Json::Value json_report;
+        write_format_version(json_report["fversion"]);
+        json_report["jobs"] = num_workers;
+        json_report["convert-ns"] = (Json::UInt64) convert_ns;
+        json_report["total-ns"] = (Json::UInt64) total_ns;
+        json_report["peak-rss"] = (Json::UInt64) get_peak_rss();
+        
+        struct Totals {
+            uint32_t m_translated = 0;
+            uint32_t m_skipped = 0;
+            uint32_t m_failed = 0;
+            Convert_Stats m_stats;
+        };
+        std::map<OType, Totals> totals;
+        for (std::size_t idx = 0; idx < m_objects.size(); ++idx) {
+            const Object& object = m_objects[idx];
+            Totals& total = totals[object.m_type];
+            if (object.m_skip_retrans) {
+                ++total.m_skipped;
+                continue;
+            }
+            if (translate_failed[idx]) {
+                ++total.m_failed;
+                continue;
+            }
+            ++total.m_translated;
+            const Convert_Stats& stats = object.m_stats;
+            total.m_stats.m_decode_ns += stats.m_decode_ns;
+            total.m_stats.m_process_ns += stats.m_process_ns;
+            total.m_stats.m_encode_ns += stats.m_encode_ns;
+            total.m_stats.m_total_ns += stats.m_total_ns;
+            total.m_stats.m_input_bytes += stats.m_input_bytes;
+            total.m_stats.m_output_bytes += stats.m_output_bytes;
+            total.m_stats.m_peak_rss = 
+                    std::max(total.m_stats.m_peak_rss, stats.m_peak_rss);
+        }
+        
+        Json::Value& json_converters = json_report["converters"];
+        for (auto& pair : totals) {
+            const Totals& total = pair.second;
+            const Convert_Stats& stats = total.m_stats;
+            Json::Value& json_conv = json_converters[pair.first];
+            json_conv["translated"] = total.m_translated;
+            json_conv["skipped"] = total.m_skipped;
+            json_conv["failed"] = total.m_failed;
+            json_conv["decode-ns"] = (Json::UInt64) stats.m_decode_ns;
+            json_conv["process-ns"] = (Json::UInt64) stats.m_process_ns;
+            json_conv["encode-ns"] = (Json::UInt64) stats.m_encode_ns;
+            json_conv["total-ns"] = (Json::UInt64) stats.m_total_ns;
+            json_conv["input-bytes"] = (Json::UInt64) stats.m_input_bytes;
+            json_conv["output-bytes"] = (Json::UInt64) stats.m_output_bytes;
+            json_conv["peak-rss"] = (Json::UInt64) stats.m_peak_rss;
+            if (stats.m_total_ns > 0) {
+                json_conv["input-bytes-per-sec"] = 
+                        ((double) stats.m_input_bytes) * 1e9 / stats.m_total_ns;
+            }
+        }
+        
+        writeJsonFile((m_conf.m_output_dir / "build.report").string(), 
+                json_report, false);
+    }
+    
+    /**
+     * @brief Rebuilds the list of objects from the resource declaration
+     * files, as done at the start of process()
+     */
+    void reload_resources() {
+        m_objects.clear();
+        parse_resource_declaration_files();
+        expand_resources();
+        detect_naming_conflicts();
+        determine_final_output_names();
+    }
+    
+    bool is_declaration_file(const boost::filesystem::path& file) {
+        return file.extension() == ".resource" 
+                || file.extension() == ".resources";
     }
 
 public:
 
+    /**
+     * @param type Type to compress, or "*" for all types not otherwise set
+     */
+    void set_pack_codec(const OType& type, const std::string& name) {
+        Codec codec;
+        if (!parse_codec(name, codec)) {
+            std::stringstream sss;
+            sss << "Unknown codec: \""
+                << name
+                << "\"";
+            throw std::runtime_error(sss.str());
+        }
+        if (!codec_available(codec)) {
+            Logger::log()->warn("resman was built without %v, "
+                    "%v will not be compressed", name, type);
+        }
+        m_conf.m_pack_codecs[type] = codec;
+    }
+
     bool preprocess() {
         try {
             load_package();
@@ -705,10 +1857,12 @@ public:
                 << e.what();
             throw std::runtime_error(sss.str());
         }
+        return true;
     }
 
     bool process() {
         try {
+            Trace_Span span("phase", "prepare_output_dir");
             prepare_output_dir();
         } catch (std::runtime_error e) {
             std::stringstream sss;
@@ -717,6 +1871,7 @@ public:
             throw std::runtime_error(sss.str());
         }
         try {
+            Trace_Span span("phase", "parse_resource_declaration_files");
             parse_resource_declaration_files();
         } catch (std::runtime_error e) {
             std::stringstream sss;
@@ -725,6 +1880,7 @@ public:
             throw std::runtime_error(sss.str());
         }
         try {
+            Trace_Span span("phase", "expand_resources");
             expand_resources();
         } catch (std::runtime_error e) {
             std::stringstream sss;
@@ -733,6 +1889,7 @@ public:
             throw std::runtime_error(sss.str());
         }
         try {
+            Trace_Span span("phase", "detect_naming_conflicts");
             detect_naming_conflicts();
         } catch (std::runtime_error e) {
             std::stringstream sss;
@@ -741,6 +1898,7 @@ public:
             throw std::runtime_error(sss.str());
         }
         try {
+            Trace_Span span("phase", "determine_final_output_names");
             determine_final_output_names();
         } catch (std::runtime_error e) {
             std::stringstream sss;
@@ -749,6 +1907,7 @@ public:
             throw std::runtime_error(sss.str());
         }
         try {
+            Trace_Span span("phase", "use_previous_intermediates");
             use_previous_intermediates();
         } catch (std::runtime_error e) {
             std::stringstream sss;
@@ -757,6 +1916,7 @@ public:
             throw std::runtime_error(sss.str());
         }
         try {
+            Trace_Span span("phase", "process_all_resources");
             process_all_resources();
         } catch (std::runtime_error e) {
             std::stringstream sss;
@@ -764,18 +1924,112 @@ public:
                 << e.what();
             throw std::runtime_error(sss.str());
         }
+        return true;
+    }
+    
+    /**
+     * @brief Keeps the project loaded after process() and rebuilds whenever
+     * something in the project tree changes. Only objects whose cache key
+     * changed are converted again; declaration files are only re-read if one
+     * of them changed. Never returns.
+     */
+    void watch() {
+        std::vector<boost::filesystem::path> ignores = m_conf.m_ignores;
+        ignores.push_back(m_conf.m_output_dir);
+        ignores.push_back(m_conf.m_interm_dir);
+        ignores.push_back(m_conf.m_cache_dir);
+        
+        boost::filesystem::path watch_root = m_package_dir;
+        if (watch_root.empty()) {
+            watch_root = ".";
+        }
+        Watcher watcher;
+        watcher.watch_tree(watch_root, ignores);
+        
+        // Written after every rebuild, which must not start another one
+        if (!n_trace_file.empty()) {
+            watcher.ignore_file(n_trace_file);
+        }
+        
+        while (true) {
+            Logger::log()->info("Watching for changes in %v...", 
+                    watch_root);
+            // Waiting can fail too, such as when running out of inotify
+            // watches, which must not end watch mode either
+            try {
+                bool missed;
+                std::vector<boost::filesystem::path> changes = 
+                        watcher.wait_for_changes(n_watch_settle_ms, missed);
+                trace_reset();
+                
+                // Without knowing what changed, anything might have
+                bool reload_package = missed;
+                bool reload_decls = missed;
+                if (missed) {
+                    Logger::log()->warn("Missed some changes, reloading "
+                            "everything");
+                }
+                for (const boost::filesystem::path& change : changes) {
+                    Logger::log()->verbose(2, "Changed: %v", change);
+                    if (change.filename() == m_package_file.filename()) {
+                        reload_package = true;
+                    }
+                    else if (change.filename() == "compile.config") {
+                        Logger::log()->warn(
+                                "Restart to apply changes to %v", change);
+                    }
+                    else if (is_declaration_file(change)
+                            || boost::filesystem::is_directory(change)) {
+                        reload_decls = true;
+                    }
+                }
+                
+                Trace_Span rebuild_span("phase", "rebuild");
+                if (reload_package) {
+                    load_package();
+                }
+                if (reload_decls) {
+                    Trace_Span span("phase", "reload_resources");
+                    reload_resources();
+                }
+                {
+                    Trace_Span span("phase", "check_cached_conversions");
+                    check_cached_conversions();
+                }
+                {
+                    Trace_Span span("phase", "process_all_resources");
+                    process_all_resources();
+                }
+            } catch (std::runtime_error& e) {
+                Logger::log()->warn("Rebuild failed: %v", e.what());
+            }
+            if (!n_trace_file.empty()) {
+                trace_write(n_trace_file);
+            }
+        }
     }
 };
 
 const char* n_help_text = 
 "Options:\n"
 "   -c, --clean         Cleans the output folder\n"
-"   -r, --reset         Deletes cache (\"intermediate\" folder)\n"
+"   -r, --reset         Deletes the \"intermediate\" folder and its cache\n"
+"   --purge-cache       Deletes every cached conversion, even if shared\n"
 "   --obfus             Enables obfuscation of output filenames\n"
 "   --nobfus            Disables obfuscation of output filenames\n"
+"   --pack              Outputs a single archive instead of loose files\n"
+"   --nopack            Outputs loose files\n"
+"   --codec <name>      Compresses archive entries: none, lz4 or zstd\n"
+"   --order <path>      Orders archive entries by a loader's access trace\n"
+"   --max-pack <mb>     Splits archives into volumes of at most this size\n"
 "   -n <path>           Adds a path to the ignore list when searching\n"
 "   -d <path>           Sets the output path, may overwrite existing contents\n"
-"   -i <path>           Where to place cached files\n"
+"   -i <path>           Where to place intermediate data\n"
+"   -s <path>           Where to place cached conversions, may be shared\n"
+"   -j <count>          Number of resources to convert at once (0 = all cores)\n"
+"   -m <megabytes>      Limits estimated memory used by concurrent conversions\n"
+"   --watch             Keeps running, rebuilding when the project changes\n"
+"   --trace <path>      Writes a timeline of the run for chrome://tracing\n"
 "   -v, --verbose       Enables verbose logging"
 ;
 
@@ -792,10 +2046,48 @@ int main(int argc, char* argv[]) {
                 cmd = argv[0];
             }
             Logger::log()->info("Usage: %v <package> [options]", cmd);
+            Logger::log()->info("       %v diff <old output> <new output> "
+                    "[patch]", cmd);
+            Logger::log()->info("       %v apply <output> <patch>", cmd);
             Logger::log()->info(n_help_text);
             return 0;
         }
         
+        if (std::strcmp(argv[1], "diff") == 0) {
+            if (argc < 4) {
+                throw std::runtime_error(
+                        "diff needs an old and a new output directory");
+            }
+            boost::filesystem::path patch_file = 
+                    argc > 4 ? argv[4] : "update.patch";
+            Patch_Stats stats = write_patch(argv[2], argv[3], patch_file);
+            Logger::log()->info("%v added, %v changed (%v as deltas), "
+                    "%v deleted, %v unchanged",
+                    stats.m_num_added, stats.m_num_changed, 
+                    stats.m_num_deltas, stats.m_num_deleted, 
+                    stats.m_num_unchanged);
+            Logger::log()->info("Wrote %v (%v bytes), "
+                    "%v files written, %v files deleted",
+                    patch_file, stats.m_patch_size, 
+                    stats.m_num_files_written, stats.m_num_files_deleted);
+            Logger::cleanup();
+            return 0;
+        }
+        if (std::strcmp(argv[1], "apply") == 0) {
+            if (argc < 4) {
+                throw std::runtime_error(
+                        "apply needs an output directory and a patch");
+            }
+            Patch_Stats stats = apply_patch(argv[2], argv[3]);
+            Logger::log()->info("%v added, %v changed, %v deleted; "
+                    "%v files written, %v files deleted",
+                    stats.m_num_added, stats.m_num_changed, 
+                    stats.m_num_deleted, stats.m_num_files_written, 
+                    stats.m_num_files_deleted);
+            Logger::cleanup();
+            return 0;
+        }
+        
         std::string package_file = argv[1];
         
         Project project(package_file);
@@ -814,6 +2106,11 @@ int main(int argc, char* argv[]) {
                 n_reset_interm = true;
                 continue;
             }
+            if (std::strcmp(argv[i], "--purge-cache") == 0) {
+                Logger::log()->info("Will purge cached conversions");
+                n_purge_cache = true;
+                continue;
+            }
             if (std::strcmp(argv[i], "--obfus") == 0) {
                 project.m_conf.m_obfuscate = true;
                 continue;
@@ -822,6 +2119,35 @@ int main(int argc, char* argv[]) {
                 project.m_conf.m_obfuscate = false;
                 continue;
             }
+            if (std::strcmp(argv[i], "--pack") == 0) {
+                project.m_conf.m_pack = true;
+                continue;
+            }
+            if (std::strcmp(argv[i], "--nopack") == 0) {
+                project.m_conf.m_pack = false;
+                continue;
+            }
+            if (std::strcmp(argv[i], "--codec") == 0) {
+                ++i;
+                if (i >= argc) continue;
+                project.m_conf.m_pack_codecs.clear();
+                project.set_pack_codec("*", argv[i]);
+                continue;
+            }
+            if (std::strcmp(argv[i], "--max-pack") == 0) {
+                ++i;
+                if (i >= argc) continue;
+                int64_t megabytes = std::atoll(argv[i]);
+                project.m_conf.m_pack_max_size = 
+                        megabytes < 0 ? 0 : megabytes << 20;
+                continue;
+            }
+            if (std::strcmp(argv[i], "--order") == 0) {
+                ++i;
+                if (i >= argc) continue;
+                project.m_conf.m_access_trace = argv[i];
+                continue;
+            }
             if (std::strcmp(argv[i], "-n") == 0) {
                 ++i;
                 if (i >= argc) continue;
@@ -843,6 +2169,38 @@ int main(int argc, char* argv[]) {
                 project.m_conf.m_interm_dir = interm_path;
                 continue;
             }
+            if (std::strcmp(argv[i], "-s") == 0) {
+                ++i;
+                if (i >= argc) continue;
+                std::string cache_path = argv[i];
+                project.m_conf.m_cache_dir = cache_path;
+                continue;
+            }
+            if (std::strcmp(argv[i], "-j") == 0) {
+                ++i;
+                if (i >= argc) continue;
+                int num_jobs = std::atoi(argv[i]);
+                n_num_jobs = num_jobs < 0 ? 1 : num_jobs;
+                continue;
+            }
+            if (std::strcmp(argv[i], "-m") == 0) {
+                ++i;
+                if (i >= argc) continue;
+                int64_t megabytes = std::atoll(argv[i]);
+                n_memory_budget = megabytes < 0 ? 0 : megabytes << 20;
+                continue;
+            }
+            if (std::strcmp(argv[i], "--watch") == 0) {
+                n_watch = true;
+                continue;
+            }
+            if (std::strcmp(argv[i], "--trace") == 0) {
+                ++i;
+                if (i >= argc) continue;
+                n_trace_file = argv[i];
+                trace_enable();
+                continue;
+            }
             if (std::strcmp(argv[i], "--verbose") == 0
                     || std::strcmp(argv[i], "-v") == 0) {
                 n_verbose = true;
@@ -851,6 +2209,12 @@ int main(int argc, char* argv[]) {
         }
         
         project.process();
+        if (!n_trace_file.empty()) {
+            trace_write(n_trace_file);
+        }
+        if (n_watch) {
+            project.watch();
+        }
     } catch (std::runtime_error e) {
         Logger::log()->fatal(e.what());
     }
@@ -1,6 +1,9 @@
 #ifndef RESMAN_MAIN_COMMON_HPP
 #define RESMAN_MAIN_COMMON_HPP
 
+#include "Convert.hpp"
+#include "Hash.hpp"
+
 namespace resman {
 
 typedef std::string OType;
@@ -13,17 +16,31 @@ struct Object {
     std::string m_name;
     OType m_type;
     boost::filesystem::path m_src_file;
-    uint32_t m_src_hash;
+    Hash128 m_src_hash;
+    uint64_t m_src_size = 0;
     
     Json::Value m_params;
-    uint32_t m_params_hash;
+    Hash128 m_params_hash;
     
     bool m_skip_retrans = false;
     bool m_force_retrans = false;
     
     bool m_expanded = false;
     
+    // Resources in the same load group are stored next to each other
+    std::string m_load_group;
+    
+    // Which archive the resource goes into when packing, empty for the
+    // default one
+    std::string m_group;
+    
+    // Files other than the source which the converter reads
+    std::vector<boost::filesystem::path> m_dependencies;
+    
     boost::filesystem::path m_interm_file;
+    
+    // Only meaningful if the object was translated in this run
+    Convert_Stats m_stats;
 
     boost::filesystem::path m_dest_file;
     uint32_t m_dest_size;
@@ -0,0 +1,137 @@
+/*
+ *  Copyright 2017 James Fong
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "Compress.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#ifdef RESMAN_HAVE_LZ4
+#include <lz4.h>
+#include <lz4hc.h>
+#endif
+
+#ifdef RESMAN_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace resman {
+
+// Compression happens once per cached conversion, so favor ratio over speed
+const int n_zstd_level = 19;
+
+const char* codec_name(Codec codec) {
+    switch (codec) {
+        case Codec::LZ4: return "lz4";
+        case Codec::ZSTD: return "zstd";
+        default: return "none";
+    }
+}
+
+bool parse_codec(const std::string& name, Codec& codec) {
+    if (name == "none") {
+        codec = Codec::NONE;
+    } else if (name == "lz4") {
+        codec = Codec::LZ4;
+    } else if (name == "zstd") {
+        codec = Codec::ZSTD;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool codec_available(Codec codec) {
+    switch (codec) {
+        case Codec::NONE: return true;
+#ifdef RESMAN_HAVE_LZ4
+        case Codec::LZ4: return true;
+#endif
+#ifdef RESMAN_HAVE_ZSTD
+        case Codec::ZSTD: return true;
+#endif
+        default: return false;
+    }
+}
+
+bool compress_file(const boost::filesystem::path& from, 
+        const boost::filesystem::path& to, Codec codec) {
+    if (codec == Codec::NONE || !codec_available(codec)) {
+        return false;
+    }
+    
+    std::vector<char> raw_data(boost::filesystem::file_size(from));
+    {
+        std::ifstream input(from.string().c_str(), std::ios::binary);
+        input.read(raw_data.data(), raw_data.size());
+        if (input.gcount() != (std::streamsize) raw_data.size()) {
+            std::stringstream sss;
+            sss << "Cannot read file for compression: "
+                << from;
+            throw std::runtime_error(sss.str());
+        }
+    }
+    
+    std::vector<char> data;
+    switch (codec) {
+#ifdef RESMAN_HAVE_LZ4
+        case Codec::LZ4: {
+            if (raw_data.size() > LZ4_MAX_INPUT_SIZE) {
+                return false;
+            }
+            data.resize(LZ4_compressBound(raw_data.size()));
+            int size = LZ4_compress_HC(raw_data.data(), data.data(), 
+                    raw_data.size(), data.size(), LZ4HC_CLEVEL_DEFAULT);
+            if (size <= 0) {
+                return false;
+            }
+            data.resize(size);
+            break;
+        }
+#endif
+#ifdef RESMAN_HAVE_ZSTD
+        case Codec::ZSTD: {
+            data.resize(ZSTD_compressBound(raw_data.size()));
+            std::size_t size = ZSTD_compress(data.data(), data.size(), 
+                    raw_data.data(), raw_data.size(), n_zstd_level);
+            if (ZSTD_isError(size)) {
+                return false;
+            }
+            data.resize(size);
+            break;
+        }
+#endif
+        default: {
+            return false;
+        }
+    }
+    
+    std::ofstream output(to.string().c_str(), 
+            std::ios::out | std::ios::binary | std::ios::trunc);
+    output.write(data.data(), data.size());
+    output.close();
+    if (output.fail()) {
+        std::stringstream sss;
+        sss << "Cannot write compressed file: "
+            << to;
+        throw std::runtime_error(sss.str());
+    }
+    return true;
+}
+
+} // namespace resman
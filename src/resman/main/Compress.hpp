@@ -0,0 +1,61 @@
+/*
+ *  Copyright 2017 James Fong
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef RESMAN_MAIN_COMPRESS_HPP
+#define RESMAN_MAIN_COMPRESS_HPP
+
+#include <cstdint>
+#include <string>
+
+#include <boost/filesystem.hpp>
+
+namespace resman {
+
+/* Codecs are optional dependencies. Asking for one that was not available
+ * at build time is not an error, the data is just stored uncompressed.
+ * Values are stored in pack archives, so they must never change.
+ */
+enum class Codec : uint32_t {
+    NONE = 0,
+    
+    // LZ4 block format, compressed with LZ4HC. Very fast to decompress,
+    // meant for data that is loaded often.
+    LZ4 = 1,
+    
+    // Zstandard frame. Smaller but slower to decompress, meant for data that
+    // is loaded rarely.
+    ZSTD = 2
+};
+
+const char* codec_name(Codec codec);
+
+/**
+ * @return false if the name is unknown, leaving codec untouched
+ */
+bool parse_codec(const std::string& name, Codec& codec);
+
+bool codec_available(Codec codec);
+
+/**
+ * @brief Compresses the whole of one file into another
+ * @return false if the codec is unavailable or the file is too big for it
+ */
+bool compress_file(const boost::filesystem::path& from, 
+        const boost::filesystem::path& to, Codec codec);
+
+} // namespace resman
+
+#endif // RESMAN_MAIN_COMPRESS_HPP
@@ -1,20 +1,73 @@
 #ifndef CONVERT_HPP
 #define CONVERT_HPP
 
+#include <chrono>
+#include <cstdint>
 #include <string>
 #include <functional>
+#include <vector>
 
 #include <boost/filesystem.hpp>
 
 #include <json/json.h>
 
 namespace resman {
+
+/**
+ * @brief Measurements taken while converting a single object, for the build
+ * report. Phase times are in nanoseconds. A converter that never marks its
+ * phases is counted as spending all of its time processing.
+ */
+struct Convert_Stats {
+    std::chrono::steady_clock::time_point m_start;
+    std::chrono::steady_clock::time_point m_decoded;
+    std::chrono::steady_clock::time_point m_processed;
+    bool m_marked_decoded = false;
+    bool m_marked_processed = false;
+    
+    uint64_t m_decode_ns = 0;
+    uint64_t m_process_ns = 0;
+    uint64_t m_encode_ns = 0;
+    uint64_t m_total_ns = 0;
+    uint64_t m_input_bytes = 0;
+    uint64_t m_output_bytes = 0;
+    
+    // Peak resident set size of the whole process once the conversion ended
+    uint64_t m_peak_rss = 0;
+};
     
 struct Convert_Args {
     boost::filesystem::path fromFile;
     boost::filesystem::path outputFile;
     Json::Value params;
     bool modifyFilename = true;
+    
+    // Converters must report every file other than fromFile that they read,
+    // otherwise changes to those files will not cause a reconversion
+    std::vector<boost::filesystem::path>* dependencies = nullptr;
+    
+    void addDependency(const boost::filesystem::path& file) const {
+        if (dependencies) {
+            dependencies->push_back(file);
+        }
+    }
+    
+    // Optional phase markers. Everything before markDecoded() is decoding,
+    // everything after markProcessed() is encoding and writing the output.
+    Convert_Stats* stats = nullptr;
+    
+    void markDecoded() const {
+        if (stats) {
+            stats->m_decoded = std::chrono::steady_clock::now();
+            stats->m_marked_decoded = true;
+        }
+    }
+    void markProcessed() const {
+        if (stats) {
+            stats->m_processed = std::chrono::steady_clock::now();
+            stats->m_marked_processed = true;
+        }
+    }
 };
 
 void convertImage(const Convert_Args& args);
@@ -28,6 +81,15 @@ void convert_bgfx_shader(const Convert_Args& args);
 
 typedef std::function<void(const Convert_Args&)> Convert_Func;
 
+/* Rough upper bounds on how many bytes a converter will have allocated at
+ * once while converting, used to keep concurrent conversions within a
+ * memory budget. These should be much cheaper than the conversion itself.
+ */
+uint64_t estimateImageMemory(const Convert_Args& args);
+uint64_t estimateGeometryMemory(const Convert_Args& args);
+
+typedef std::function<uint64_t(const Convert_Args&)> Estimate_Func;
+
 } // namespace resman
 
 #endif // CONVERT_HPP
@@ -131,6 +131,7 @@ void convertFont(const Convert_Args& args) {
         fileStream >> fontData;
         fileStream.close();
     }
+    args.markDecoded();
 
     const Json::Value& metricsData = fontData["metrics"];
 
@@ -150,7 +151,9 @@ void convertFont(const Convert_Args& args) {
     font.padding = metricsData["padding"].asFloat();
     font.texture = renderingData["texture"].asString();
 
-    generateMetrics(font, args.fromFile.parent_path() / (metricsData["imageFile"].asString()));
+    boost::filesystem::path metricsImageFile = args.fromFile.parent_path() / (metricsData["imageFile"].asString());
+    args.addDependency(metricsImageFile);
+    generateMetrics(font, metricsImageFile);
 
     // Load special cases
     const Json::Value& manualData = metricsData["manual"];
@@ -167,6 +170,7 @@ void convertFont(const Convert_Args& args) {
         }
     }
 
+    args.markProcessed();
     {
         std::ofstream outputData(args.outputFile.string().c_str(), std::ios::out | std::ios::binary);
 
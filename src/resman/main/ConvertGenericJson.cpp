@@ -22,6 +22,8 @@ namespace resman {
 
 void convertGenericJson(const Convert_Args& args) {
     Json::Value jsonFile = readJsonFile(args.fromFile.string());
+    args.markDecoded();
+    args.markProcessed();
     writeJsonFile(args.outputFile.string(), jsonFile);
 }
 
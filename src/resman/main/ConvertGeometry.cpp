@@ -447,6 +447,13 @@ uint32_t recursiveBuildBoneStructure(const aiNode* copyFrom, BoneBuffer& bones,
     return boneIndex;
 }
 
+uint64_t estimateGeometryMemory(const Convert_Args& args) {
+    // Vertex counts are not known without having Assimp parse the whole file,
+    // which is most of the cost of converting it. The imported scene plus the
+    // Mesh copy of it tend to be within a small multiple of the source size.
+    return boost::filesystem::file_size(args.fromFile) * 8;
+}
+
 void convertGeometry(const Convert_Args& args) {
     // Importer must be kept alive.
     // Importer destroys imported data upon destruction.
@@ -668,6 +675,7 @@ void convertGeometry(const Convert_Args& args) {
      
     // Import scene
     const aiScene* aScene = assimp.ReadFile(args.fromFile.string().c_str(), importFlags);
+    args.markDecoded();
 
     // Display debug information
     debugAssimp(assimp, aScene);
@@ -923,6 +931,7 @@ void convertGeometry(const Convert_Args& args) {
     std::cout << "\tBones: " << output.mBones.size() << std::endl;
     std::cout << "\tLightprobes: " << output.mLightprobes.size() << std::endl;
     
+    args.markProcessed();
     outputMesh(output, args.outputFile);
     
     // Debug
@@ -88,7 +88,9 @@ void convertGlsl(const Convert_Args& args) {
     ss << " -V -o ";
     ss << args.outputFile.string();
     //std::cout << ss.str() << std::endl;
+    args.markDecoded();
     std::system(ss.str().c_str());
+    args.markProcessed();
     
     /* SPV_ENV_UNIVERSAL_1_0
      * SPV_ENV_VULKAN_1_0
@@ -29,6 +29,30 @@
 
 namespace resman {
 
+uint64_t estimateImageMemory(const Convert_Args& args) {
+    int width;
+    int height;
+    int components;
+    if (!stbi_info(args.fromFile.string().c_str(), 
+            &width, &height, &components)) {
+        return boost::filesystem::file_size(args.fromFile);
+    }
+    uint64_t pixels = ((uint64_t) width) * height;
+    
+    // Decoded image, plus a new buffer and the buffer it replaces for 
+    // whichever step is running
+    uint64_t retval = pixels * components * 3;
+    
+    // Voronoi-style passes keep two 32-bit coordinates per pixel on top of 
+    // that. (Output size can differ from the input, but rarely by much.)
+    if (!args.params["voronoi"].isNull()
+            || !args.params["pixelDisplacementField"].isNull()
+            || !args.params["distanceField"].isNull()) {
+        retval += pixels * 8;
+    }
+    return retval;
+}
+
 void convertImage(const Convert_Args& args) {
 
     int width;
@@ -40,6 +64,7 @@ void convertImage(const Convert_Args& args) {
         std::cout << "\tFailed to read image!" << std::endl;
         return;
     }
+    args.markDecoded();
 
     bool writeAsDebug = false;
     bool manuallyFreeImage = false;
@@ -1069,6 +1094,7 @@ void convertImage(const Convert_Args& args) {
     std::cout << "\tComponents: " << components << std::endl;
     std::cout << "\tRaw array size: " << (width * height * components) << std::endl;
 
+    args.markProcessed();
     //if (writeAsDebug) {
     if (true) {
         int result = stbi_write_png(args.outputFile.string().c_str(), width, height, components, image, 0);
@@ -19,6 +19,9 @@
 namespace resman {
 
 void convertMiscellaneous(const Convert_Args& args) {
+    // Nothing to decode or process, it is all copying
+    args.markDecoded();
+    args.markProcessed();
     boost::filesystem::copy_file(args.fromFile, args.outputFile);
 }
 
@@ -321,6 +321,11 @@ void convertWaveform(const Convert_Args& args) {
                 }
             }
             
+            // Samples are decoded and encoded in the same loop, which counts
+            // as encoding
+            args.markDecoded();
+            args.markProcessed();
+            
             // Write intialization
             vorbis_info outputVorbisInfo;
             vorbis_info_init(&outputVorbisInfo);
@@ -483,6 +488,10 @@ void convertWaveform(const Convert_Args& args) {
                 return;
             }
             
+            // Samples are encoded from the decoder's callback, as with
+            // ogg-vorbis that all counts as encoding
+            args.markDecoded();
+            args.markProcessed();
             FLAC__stream_decoder_process_until_end_of_stream(inputFlacDecoder);
             
             std::cout << "\tFLAC decoder status: "
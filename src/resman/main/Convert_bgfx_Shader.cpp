@@ -3,6 +3,7 @@
 #include <cassert>
 #include <stdexcept>
 #include <vector>
+#include <fstream>
 #include <sstream>
 
 #include "resman/logger/Logger.hpp"
@@ -98,12 +99,48 @@ const T& resolve(std::string input,
     throw std::runtime_error(sss.str());
 }
 
+/**
+ * @brief Reports every file listed in a makefile-style depends file written
+ * by shaderc (the included headers) as a dependency
+ */
+void read_depends_file(const boost::filesystem::path& depends_file, 
+        const Convert_Args& args) {
+    std::ifstream input(depends_file.string().c_str());
+    if (!input) {
+        return;
+    }
+    std::stringstream contents;
+    contents << input.rdbuf();
+    
+    // "target : dep1 dep2 \"
+    std::string word;
+    bool past_target = false;
+    while (contents >> word) {
+        if (!past_target) {
+            if (word.back() == ':') {
+                past_target = true;
+            }
+            continue;
+        }
+        if (word == "\\") {
+            continue;
+        }
+        boost::filesystem::path dependency = word;
+        boost::system::error_code error;
+        if (!boost::filesystem::equivalent(dependency, args.fromFile, error)) {
+            args.addDependency(dependency);
+        }
+    }
+}
+
 void convert_bgfx_shader(const Convert_Args& args) {
     
     Json::Value json_platform = args.params["platform"];
     Json::Value json_type = args.params["type"];
     
     if (json_platform.asString() == "src") {
+        args.markDecoded();
+        args.markProcessed();
         boost::filesystem::copy(args.fromFile, args.outputFile);
         return;
     }
@@ -130,6 +167,9 @@ void convert_bgfx_shader(const Convert_Args& args) {
         throw std::runtime_error(sss.str());
     }
     
+    boost::filesystem::path depends_file = args.outputFile;
+    depends_file += ".d";
+    
     std::stringstream cmd;
     cmd << "shaderc"
         << " -f "
@@ -141,8 +181,24 @@ void convert_bgfx_shader(const Convert_Args& args) {
         << " --platform "
         << sc_platform
         << " --type "
-        << sc_type;
+        << sc_type
+        << " --depends";
+    
+    // shaderc reads, compiles and writes in one go, which counts as
+    // processing
+    args.markDecoded();
     std::system(cmd.str().c_str());
+    args.markProcessed();
+    
+    // Default varying definitions are read from next to the source
+    boost::filesystem::path varying_def = 
+            args.fromFile.parent_path() / "varying.def.sc";
+    if (boost::filesystem::exists(varying_def)) {
+        args.addDependency(varying_def);
+    }
+    read_depends_file(depends_file, args);
+    boost::system::error_code ignored;
+    boost::filesystem::remove(depends_file, ignored);
     
     if (!boost::filesystem::exists(args.outputFile)
             || boost::filesystem::file_size(args.outputFile) == 0) {
@@ -0,0 +1,168 @@
+/*
+ *  Copyright 2017 James Fong
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include "Delta.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace resman {
+
+// Smallest run worth a copy instruction. Also the spacing of the blocks of
+// the old data that are remembered.
+const std::size_t n_delta_block_size = 32;
+
+const uint32_t n_delta_hash_base = 257;
+
+const uint8_t n_delta_op_copy = 0;
+const uint8_t n_delta_op_insert = 1;
+
+namespace {
+
+void put_u64(std::string& out, uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        out.push_back((char) ((value >> (i * 8)) & 0xff));
+    }
+}
+
+uint64_t get_u64(const char* delta, std::size_t delta_size, 
+        std::size_t& pos) {
+    if (delta_size - pos < 8) {
+        throw std::runtime_error("Delta is truncated");
+    }
+    uint64_t value = 0;
+    for (int i = 0; i < 8; ++i) {
+        value |= ((uint64_t) (uint8_t) delta[pos + i]) << (i * 8);
+    }
+    pos += 8;
+    return value;
+}
+
+// Polynomial hash of one block. Overflow is intended; everything is mod 2^32.
+uint32_t hash_block(const char* data) {
+    uint32_t hash = 0;
+    for (std::size_t i = 0; i < n_delta_block_size; ++i) {
+        hash = hash * n_delta_hash_base + (uint8_t) data[i];
+    }
+    return hash;
+}
+
+void put_insert(std::string& out, const char* data, std::size_t size) {
+    if (size == 0) {
+        return;
+    }
+    out.push_back((char) n_delta_op_insert);
+    put_u64(out, size);
+    out.append(data, size);
+}
+
+} // namespace
+
+std::string make_delta(const char* old_data, std::size_t old_size, 
+        const char* new_data, std::size_t new_size) {
+    // Only whole blocks of the old data are remembered, but every offset of
+    // the new data is tried, so a match is found whatever the alignment.
+    std::unordered_map<uint32_t, std::size_t> blocks;
+    blocks.reserve(old_size / n_delta_block_size);
+    for (std::size_t offset = 0; offset + n_delta_block_size <= old_size;
+            offset += n_delta_block_size) {
+        blocks.emplace(hash_block(old_data + offset), offset);
+    }
+    
+    // Weight of the byte that leaves the window when rolling
+    uint32_t leaving_weight = 1;
+    for (std::size_t i = 1; i < n_delta_block_size; ++i) {
+        leaving_weight *= n_delta_hash_base;
+    }
+    
+    std::string delta;
+    std::size_t insert_start = 0;
+    std::size_t pos = 0;
+    uint32_t hash = 0;
+    bool hash_valid = false;
+    while (pos + n_delta_block_size <= new_size) {
+        if (!hash_valid) {
+            hash = hash_block(new_data + pos);
+            hash_valid = true;
+        }
+        auto iter = blocks.find(hash);
+        if (iter != blocks.end() && std::memcmp(old_data + iter->second, 
+                new_data + pos, n_delta_block_size) == 0) {
+            std::size_t old_pos = iter->second;
+            std::size_t size = n_delta_block_size;
+            while (old_pos + size < old_size && pos + size < new_size 
+                    && old_data[old_pos + size] == new_data[pos + size]) {
+                ++size;
+            }
+            // Take back bytes that were about to be inserted
+            while (pos > insert_start && old_pos > 0 
+                    && old_data[old_pos - 1] == new_data[pos - 1]) {
+                --pos;
+                --old_pos;
+                ++size;
+            }
+            put_insert(delta, new_data + insert_start, pos - insert_start);
+            delta.push_back((char) n_delta_op_copy);
+            put_u64(delta, old_pos);
+            put_u64(delta, size);
+            pos += size;
+            insert_start = pos;
+            hash_valid = false;
+            continue;
+        }
+        if (pos + n_delta_block_size < new_size) {
+            hash = (hash - (uint8_t) new_data[pos] * leaving_weight) 
+                    * n_delta_hash_base 
+                    + (uint8_t) new_data[pos + n_delta_block_size];
+        }
+        ++pos;
+    }
+    put_insert(delta, new_data + insert_start, new_size - insert_start);
+    return delta;
+}
+
+std::string apply_delta(const char* old_data, std::size_t old_size, 
+        const char* delta, std::size_t delta_size) {
+    std::string retval;
+    std::size_t pos = 0;
+    while (pos < delta_size) {
+        uint8_t op = delta[pos];
+        ++pos;
+        if (op == n_delta_op_copy) {
+            uint64_t offset = get_u64(delta, delta_size, pos);
+            uint64_t size = get_u64(delta, delta_size, pos);
+            if (offset > old_size || size > old_size - offset) {
+                throw std::runtime_error("Delta copies past the old data");
+            }
+            retval.append(old_data + offset, size);
+        } else if (op == n_delta_op_insert) {
+            uint64_t size = get_u64(delta, delta_size, pos);
+            if (size > delta_size - pos) {
+                throw std::runtime_error("Delta is truncated");
+            }
+            retval.append(delta + pos, size);
+            pos += size;
+        } else {
+            throw std::runtime_error("Delta has an unknown instruction");
+        }
+    }
+    return retval;
+}
+
+} // namespace resman
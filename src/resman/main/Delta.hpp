@@ -0,0 +1,57 @@
+/*
+ *  Copyright 2017 James Fong
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#ifndef RESMAN_MAIN_DELTA_HPP
+#define RESMAN_MAIN_DELTA_HPP
+
+#include <cstddef>
+#include <string>
+
+namespace resman {
+
+/* Delta encoding, a sequence of instructions. All integers are
+ * little-endian.
+ * 
+ * Copy bytes from the old data:
+ *     u8      0
+ *     u64     offset in the old data
+ *     u64     size
+ * 
+ * Insert bytes stored in the delta:
+ *     u8      1
+ *     u64     size
+ *     u8[]    bytes
+ */
+
+/**
+ * @brief Describes new_data as pieces of old_data plus inserted bytes. Runs
+ * of at least one block that also appear anywhere in old_data are found with
+ * a rolling hash, so moved or partly rewritten blobs still delta well.
+ */
+std::string make_delta(const char* old_data, std::size_t old_size, 
+        const char* new_data, std::size_t new_size);
+
+/**
+ * @brief Reverses make_delta(). Throws if the delta is corrupt or does not
+ * belong to old_data.
+ */
+std::string apply_delta(const char* old_data, std::size_t old_size, 
+        const char* delta, std::size_t delta_size);
+
+} // namespace resman
+
+#endif // RESMAN_MAIN_DELTA_HPP
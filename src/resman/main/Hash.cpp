@@ -0,0 +1,153 @@
+/*
+ *  Copyright 2017 James Fong
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "Hash.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include <MurmurHash3.h>
+
+namespace resman {
+
+const uint32_t n_hash_seed = 0xdaff0d11;
+
+// Small enough to keep the read buffer cheap, large enough that the list of
+// chunk hashes stays tiny even for multi-gigabyte files
+const std::size_t n_hash_chunk_size = 1 << 20;
+
+std::string Hash128::to_string() const {
+    const char* digits = "0123456789abcdef";
+    std::string retval(32, '0');
+    for (int i = 0; i < 16; ++i) {
+        retval[15 - i] = digits[(m_high >> (i * 4)) & 0xf];
+        retval[31 - i] = digits[(m_low >> (i * 4)) & 0xf];
+    }
+    return retval;
+}
+
+bool Hash128::from_string(const std::string& str, Hash128& hash) {
+    if (str.size() != 32) {
+        return false;
+    }
+    Hash128 parsed;
+    for (std::size_t i = 0; i < 32; ++i) {
+        char c = str[i];
+        uint64_t nibble;
+        if (c >= '0' && c <= '9') {
+            nibble = c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            nibble = c - 'a' + 10;
+        } else {
+            return false;
+        }
+        uint64_t& half = i < 16 ? parsed.m_high : parsed.m_low;
+        half = (half << 4) | nibble;
+    }
+    hash = parsed;
+    return true;
+}
+
+bool Hash128::operator==(const Hash128& other) const {
+    return m_low == other.m_low && m_high == other.m_high;
+}
+
+bool Hash128::operator!=(const Hash128& other) const {
+    return !(*this == other);
+}
+
+bool Hash128::operator<(const Hash128& other) const {
+    return m_high != other.m_high ? m_high < other.m_high 
+            : m_low < other.m_low;
+}
+
+std::ostream& operator<<(std::ostream& out, const Hash128& hash) {
+    return out << hash.to_string();
+}
+
+Hash128 hash_data(const void* data, std::size_t size) {
+    uint64_t out[2];
+    MurmurHash3_x64_128(data, size, n_hash_seed, out);
+    Hash128 retval;
+    retval.m_low = out[0];
+    retval.m_high = out[1];
+    return retval;
+}
+
+uint64_t hash_name(const std::string& name) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (char c : name) {
+        hash ^= (uint8_t) c;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+Hash128 hash_file(const boost::filesystem::path& file) {
+    std::ifstream input(file.string().c_str(), std::ios::binary);
+    if (input.fail()) {
+        std::stringstream sss;
+        sss << "Cannot open file for hashing: "
+            << file;
+        throw std::runtime_error(sss.str());
+    }
+
+    std::vector<char> buffer(n_hash_chunk_size);
+    std::vector<uint64_t> chunk_hashes;
+    uint64_t total_size = 0;
+    while (input) {
+        input.read(buffer.data(), buffer.size());
+        std::streamsize num_read = input.gcount();
+        if (num_read <= 0) {
+            break;
+        }
+        uint64_t out[2];
+        MurmurHash3_x64_128(buffer.data(), num_read, n_hash_seed, out);
+        chunk_hashes.push_back(out[0]);
+        chunk_hashes.push_back(out[1]);
+        total_size += num_read;
+    }
+    if (input.bad()) {
+        std::stringstream sss;
+        sss << "Error while reading file for hashing: "
+            << file;
+        throw std::runtime_error(sss.str());
+    }
+
+    chunk_hashes.push_back(total_size);
+    return hash_data(chunk_hashes.data(),
+            chunk_hashes.size() * sizeof(uint64_t));
+}
+
+uint64_t checksum_data(const void* data, std::size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    std::vector<uint64_t> chunk_hashes;
+    for (std::size_t offset = 0; offset < size; offset += n_hash_chunk_size) {
+        std::size_t chunk_size = std::min(n_hash_chunk_size, size - offset);
+        uint64_t out[2];
+        MurmurHash3_x64_128(bytes + offset, chunk_size, n_hash_seed, out);
+        chunk_hashes.push_back(out[0]);
+        chunk_hashes.push_back(out[1]);
+    }
+    chunk_hashes.push_back(size);
+    return hash_data(chunk_hashes.data(),
+            chunk_hashes.size() * sizeof(uint64_t)).m_low;
+}
+
+} // namespace resman
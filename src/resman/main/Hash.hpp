@@ -0,0 +1,76 @@
+/*
+ *  Copyright 2017 James Fong
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef RESMAN_MAIN_HASH_HPP
+#define RESMAN_MAIN_HASH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include <boost/filesystem.hpp>
+
+namespace resman {
+
+/**
+ * @class Hash128
+ * @brief 128-bit content hash. Stored in json files as 32 hex digits.
+ */
+struct Hash128 {
+    uint64_t m_low = 0;
+    uint64_t m_high = 0;
+
+    std::string to_string() const;
+
+    /**
+     * @return false if the string is not a valid hash, leaving hash untouched
+     */
+    static bool from_string(const std::string& str, Hash128& hash);
+
+    bool operator==(const Hash128& other) const;
+    bool operator!=(const Hash128& other) const;
+    bool operator<(const Hash128& other) const;
+};
+
+std::ostream& operator<<(std::ostream& out, const Hash128& hash);
+
+Hash128 hash_data(const void* data, std::size_t size);
+
+/**
+ * @brief 64-bit FNV-1a hash of a resource name. Used for lookups at run-time,
+ * so this must never change and must match every loader.
+ */
+uint64_t hash_name(const std::string& name);
+
+/**
+ * @brief Hashes the contents of a file without holding all of it in memory.
+ * The file is read in fixed-size chunks which are each hashed with
+ * MurmurHash3_x64_128. The list of chunk hashes is then hashed again to get
+ * the final result.
+ */
+Hash128 hash_file(const boost::filesystem::path& file);
+
+/**
+ * @brief Fast 64-bit checksum of a resource's stored bytes, checked by
+ * loaders. Equal to the low half of hash_file() on the same bytes, so that
+ * it is free wherever the file hash is already known.
+ */
+uint64_t checksum_data(const void* data, std::size_t size);
+
+} // namespace resman
+
+#endif // RESMAN_MAIN_HASH_HPP
@@ -0,0 +1,207 @@
+/*
+ *  Copyright 2017 James Fong
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "IdHeader.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <set>
+#include <stdexcept>
+
+#include "resman/logger/Logger.hpp"
+
+#include "Hash.hpp"
+
+namespace resman {
+
+namespace {
+
+/**
+ * @brief Identifiers which cannot be declared in the generated header: C++
+ * keywords, alternative operator tokens and what the header itself declares
+ */
+const std::set<std::string> n_reserved_identifiers = {
+    "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor", 
+    "bool", "break", "case", "catch", "char", "char8_t", "char16_t", 
+    "char32_t", "class", "compl", "concept", "const", "consteval", 
+    "constexpr", "constinit", "const_cast", "continue", "co_await", 
+    "co_return", "co_yield", "decltype", "default", "delete", "do", 
+    "double", "dynamic_cast", "else", "enum", "explicit", "export", 
+    "extern", "false", "float", "for", "friend", "goto", "if", "inline", 
+    "int", "long", "mutable", "namespace", "new", "noexcept", "not", 
+    "not_eq", "nullptr", "operator", "or", "or_eq", "private", "protected", 
+    "public", "register", "reinterpret_cast", "requires", "return", "short", 
+    "signed", "sizeof", "static", "static_assert", "static_cast", "struct", 
+    "switch", "template", "this", "thread_local", "throw", "true", "try", 
+    "typedef", "typeid", "typename", "union", "unsigned", "using", "virtual", 
+    "void", "volatile", "wchar_t", "while", "xor", "xor_eq", 
+    "hash_name", "uint8_t", "uint64_t"
+};
+
+std::string make_identifier(const std::string& name) {
+    std::string retval;
+    for (char c : name) {
+        if (std::isalnum((unsigned char) c) || c == '_') {
+            retval += c;
+        } else {
+            retval += '_';
+        }
+    }
+    
+    // Leading underscores are reserved for the implementation
+    if (retval.empty() || std::isdigit((unsigned char) retval[0])
+            || retval[0] == '_' 
+            || n_reserved_identifiers.count(retval) > 0) {
+        retval = "id_" + retval;
+    }
+    return retval;
+}
+
+std::string make_guard(const std::string& filename) {
+    std::string retval;
+    for (char c : filename) {
+        if (std::isalnum((unsigned char) c)) {
+            retval += std::toupper((unsigned char) c);
+        } else {
+            retval += '_';
+        }
+    }
+    return retval;
+}
+
+/**
+ * @brief Escapes a name for use in a string literal
+ */
+std::string quote(const std::string& name) {
+    std::stringstream sss;
+    sss << '"';
+    for (char c : name) {
+        if (c == '"' || c == '\\') {
+            sss << '\\' << c;
+        } else if (std::isprint((unsigned char) c)) {
+            sss << c;
+        } else {
+            sss << "\\x" << std::hex << std::setw(2) << std::setfill('0')
+                << (int) (unsigned char) c << std::dec << "\"\"";
+        }
+    }
+    sss << '"';
+    return sss.str();
+}
+
+} // namespace
+
+bool write_id_header(const boost::filesystem::path& file, 
+        std::vector<std::string> names, const std::string& name_space) {
+    std::sort(names.begin(), names.end());
+    
+    std::string guard = 
+            "RESMAN_" + make_guard(file.filename().string());
+    
+    std::stringstream sss;
+    sss << "// Generated by resman, do not edit\n"
+        << "\n"
+        << "#ifndef " << guard << "\n"
+        << "#define " << guard << "\n"
+        << "\n"
+        << "#include <cstdint>\n"
+        << "\n"
+        << "namespace " << name_space << " {\n"
+        << "\n"
+        << "// 64-bit FNV-1a, the same hash used by data.index\n"
+        << "constexpr uint64_t hash_name(const char* name, \n"
+        << "        uint64_t hash = 0xcbf29ce484222325ULL) {\n"
+        << "    return *name == '\\0' ? hash : hash_name(name + 1, \n"
+        << "            (hash ^ (uint8_t) *name) * 0x100000001b3ULL);\n"
+        << "}\n"
+        << "\n";
+    
+    std::map<std::string, std::string> identifiers;
+    for (const std::string& name : names) {
+        std::string identifier = make_identifier(name);
+        
+        // Different names can only turn into the same identifier through
+        // replaced characters or the prefix, so a suffix keeps them apart.
+        // Which name gets it depends on the other names, so say so.
+        std::string unique = identifier;
+        for (int suffix = 2; identifiers.count(unique); ++suffix) {
+            std::stringstream ss_unique;
+            ss_unique << identifier << "_" << suffix;
+            unique = ss_unique.str();
+        }
+        if (unique != identifier) {
+            Logger::log()->warn("Resources %v and %v both map to id %v, "
+                    "using %v for the latter", identifiers[identifier], 
+                    name, identifier, unique);
+        }
+        identifiers[unique] = name;
+        
+        sss << "constexpr uint64_t " << unique << " = 0x" 
+            << std::hex << std::setw(16) << std::setfill('0') 
+            << hash_name(name) << std::dec << "ULL; // " 
+            << quote(name) << "\n";
+    }
+    if (!names.empty()) {
+        const std::string& name = names.front();
+        sss << "\n"
+            << "static_assert(hash_name(" << quote(name) << ") == 0x"
+            << std::hex << std::setw(16) << std::setfill('0')
+            << hash_name(name) << std::dec << "ULL, \n"
+            << "        \"hash_name() does not match resman\");\n";
+    }
+    sss << "\n"
+        << "} // namespace " << name_space << "\n"
+        << "\n"
+        << "#endif // " << guard << "\n";
+    std::string contents = sss.str();
+    
+    {
+        std::ifstream input(file.string().c_str(), std::ios::binary);
+        if (input) {
+            std::stringstream ss_old;
+            ss_old << input.rdbuf();
+            if (ss_old.str() == contents) {
+                return false;
+            }
+        }
+    }
+    
+    if (!file.parent_path().empty()) {
+        boost::filesystem::create_directories(file.parent_path());
+    }
+    boost::filesystem::path partial_file = file;
+    partial_file += ".partial";
+    {
+        std::ofstream output(partial_file.string().c_str(), 
+                std::ios::out | std::ios::binary | std::ios::trunc);
+        output << contents;
+        output.close();
+        if (output.fail()) {
+            std::stringstream ss_err;
+            ss_err << "Cannot write id header: "
+                << file;
+            throw std::runtime_error(ss_err.str());
+        }
+    }
+    boost::filesystem::rename(partial_file, file);
+    return true;
+}
+
+} // namespace resman
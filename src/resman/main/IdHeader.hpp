@@ -0,0 +1,49 @@
+/*
+ *  Copyright 2017 James Fong
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef RESMAN_MAIN_IDHEADER_HPP
+#define RESMAN_MAIN_IDHEADER_HPP
+
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+namespace resman {
+
+/**
+ * @brief Writes a C++ header declaring a constexpr hash_name() of every
+ * resource name, so that code can refer to resources by 64-bit id and a
+ * misspelled name fails to compile. Names are turned into identifiers by
+ * replacing anything other than letters, digits and underscores with
+ * underscores, and prefixing "id_" if they would start with a digit or an
+ * underscore, or be a C++ keyword or something the header declares. If
+ * that makes two identifiers equal, the later name in sorted order gets a
+ * numeric suffix and a warning is logged.
+ * 
+ * The file is left untouched if its contents would not change, so that
+ * code including it is not rebuilt needlessly.
+ * 
+ * @param names Every resource name, in any order
+ * @param name_space Namespace to put the ids in
+ * @return Whether the file was written
+ */
+bool write_id_header(const boost::filesystem::path& file, 
+        std::vector<std::string> names, const std::string& name_space);
+
+} // namespace resman
+
+#endif // RESMAN_MAIN_IDHEADER_HPP
@@ -0,0 +1,397 @@
+/*
+ *  Copyright 2017 James Fong
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "Index.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+#include "Hash.hpp"
+#include "StreamWrite.hpp"
+
+namespace resman {
+
+const char n_index_magic[8] = {'R', 'E', 'S', 'M', 'I', 'N', 'D', 'X'};
+
+// Average number of names per bucket. Higher makes a smaller bucket table but
+// takes longer to find displacements for.
+const uint32_t n_index_bucket_load = 2;
+
+// Giving up is only realistic if the hash function is broken
+const uint32_t n_index_max_displacement = 1 << 24;
+
+uint32_t index_slot(uint64_t hash, uint32_t displacement, 
+        uint32_t num_entries) {
+    // MurmurHash3's 64-bit finalizer
+    uint64_t mixed = hash + displacement * 0x9e3779b97f4a7c15ULL;
+    mixed ^= mixed >> 33;
+    mixed *= 0xff51afd7ed558ccdULL;
+    mixed ^= mixed >> 33;
+    mixed *= 0xc4ceb9fe1a85ec53ULL;
+    mixed ^= mixed >> 33;
+    return mixed % num_entries;
+}
+
+uint64_t merkle_parent(uint64_t left, uint64_t right) {
+    uint64_t pair[2] = {left, right};
+    return hash_data(pair, sizeof(pair)).m_low;
+}
+
+namespace {
+
+/**
+ * @brief Hash and displace: buckets are placed largest first, each with the
+ * first displacement that sends all of its names to free records.
+ * @param slots Set to the record of each entry
+ */
+void build_perfect_hash(const std::vector<uint64_t>& hashes, 
+        std::vector<uint32_t>& displacements, std::vector<uint32_t>& slots) {
+    uint32_t num_entries = hashes.size();
+    uint32_t num_buckets = 
+            std::max<uint32_t>(1, num_entries / n_index_bucket_load);
+    
+    std::vector<std::vector<uint32_t> > buckets(num_buckets);
+    for (uint32_t idx = 0; idx < num_entries; ++idx) {
+        buckets[hashes[idx] % num_buckets].push_back(idx);
+    }
+    std::vector<uint32_t> order(num_buckets);
+    for (uint32_t idx = 0; idx < num_buckets; ++idx) {
+        order[idx] = idx;
+    }
+    std::stable_sort(order.begin(), order.end(), 
+            [&buckets](uint32_t a, uint32_t b)->bool {
+                return buckets[a].size() > buckets[b].size();
+            });
+    
+    displacements.assign(num_buckets, 0);
+    slots.assign(num_entries, 0);
+    std::vector<bool> taken(num_entries, false);
+    std::vector<uint32_t> tried;
+    for (uint32_t bucket_idx : order) {
+        const std::vector<uint32_t>& bucket = buckets[bucket_idx];
+        if (bucket.empty()) {
+            break;
+        }
+        uint32_t displacement = 0;
+        while (true) {
+            tried.clear();
+            bool fits = true;
+            for (uint32_t entry_idx : bucket) {
+                uint32_t slot = index_slot(hashes[entry_idx], displacement, 
+                        num_entries);
+                if (taken[slot] || std::find(tried.begin(), tried.end(), 
+                        slot) != tried.end()) {
+                    fits = false;
+                    break;
+                }
+                tried.push_back(slot);
+            }
+            if (fits) {
+                break;
+            }
+            ++displacement;
+            if (displacement >= n_index_max_displacement) {
+                throw std::runtime_error(
+                        "Could not build a perfect hash of resource names");
+            }
+        }
+        displacements[bucket_idx] = displacement;
+        for (std::size_t idx = 0; idx < bucket.size(); ++idx) {
+            slots[bucket[idx]] = tried[idx];
+            taken[tried[idx]] = true;
+        }
+    }
+}
+
+} // namespace
+
+void write_index(const boost::filesystem::path& file, 
+        const std::vector<Index_Entry>& entries, bool merkle_root,
+        uint32_t resource_version) {
+    std::vector<uint64_t> hashes;
+    std::map<uint64_t, const std::string*> names_by_hash;
+    for (const Index_Entry& entry : entries) {
+        uint64_t hash = hash_name(entry.m_name);
+        auto iter = names_by_hash.find(hash);
+        if (iter != names_by_hash.end()) {
+            std::stringstream sss;
+            sss << "Resource names \""
+                << *(iter->second)
+                << "\" and \""
+                << entry.m_name
+                << "\" have the same hash, rename one of them";
+            throw std::runtime_error(sss.str());
+        }
+        names_by_hash[hash] = &entry.m_name;
+        hashes.push_back(hash);
+    }
+    
+    std::vector<uint32_t> displacements;
+    std::vector<uint32_t> slots;
+    if (!entries.empty()) {
+        build_perfect_hash(hashes, displacements, slots);
+    } else {
+        displacements.push_back(0);
+    }
+    
+    std::string pool;
+    std::map<std::string, uint32_t> pooled;
+    auto add_string = [&pool, &pooled](const std::string& str)->uint32_t {
+        auto iter = pooled.find(str);
+        if (iter != pooled.end()) {
+            return iter->second;
+        }
+        uint32_t offset = pool.size();
+        pool += str;
+        pooled[str] = offset;
+        return offset;
+    };
+    
+    std::vector<std::string> types;
+    std::map<std::string, uint32_t> type_ids;
+    std::vector<uint32_t> entry_type_ids;
+    for (const Index_Entry& entry : entries) {
+        auto iter = type_ids.find(entry.m_type);
+        if (iter == type_ids.end()) {
+            iter = type_ids.emplace(entry.m_type, types.size()).first;
+            types.push_back(entry.m_type);
+        }
+        entry_type_ids.push_back(iter->second);
+    }
+    
+    uint64_t types_offset = n_index_header_size;
+    uint64_t buckets_offset = types_offset + types.size() * 8;
+    uint64_t records_offset = 
+            (buckets_offset + displacements.size() * 4 + 7) / 8 * 8;
+    uint64_t strings_offset = 
+            records_offset + entries.size() * n_index_record_size;
+    
+    // Records are written in slot order
+    std::vector<const Index_Entry*> records(entries.size());
+    std::vector<uint32_t> record_type_ids(entries.size());
+    for (std::size_t idx = 0; idx < entries.size(); ++idx) {
+        records[slots[idx]] = &entries[idx];
+        record_type_ids[slots[idx]] = entry_type_ids[idx];
+    }
+    
+    uint32_t flags = 0;
+    uint64_t root = 0;
+    if (merkle_root) {
+        flags |= n_index_flag_merkle_root;
+        std::vector<uint64_t> level;
+        for (const Index_Entry* entry : records) {
+            level.push_back(entry->m_checksum);
+        }
+        while (level.size() > 1) {
+            std::vector<uint64_t> parents;
+            for (std::size_t idx = 0; idx + 1 < level.size(); idx += 2) {
+                parents.push_back(merkle_parent(level[idx], level[idx + 1]));
+            }
+            if (level.size() % 2 == 1) {
+                parents.push_back(level.back());
+            }
+            level.swap(parents);
+        }
+        if (!level.empty()) {
+            root = level.front();
+        }
+    }
+    
+    std::ofstream output(file.string().c_str(), 
+            std::ios::out | std::ios::binary | std::ios::trunc);
+    if (output.fail()) {
+        std::stringstream sss;
+        sss << "Cannot open index for writing: "
+            << file;
+        throw std::runtime_error(sss.str());
+    }
+    output.write(n_index_magic, sizeof(n_index_magic));
+    writeU32(output, n_index_version);
+    writeU32(output, entries.size());
+    writeU32(output, displacements.size());
+    writeU32(output, types.size());
+    writeU64(output, types_offset);
+    writeU64(output, buckets_offset);
+    writeU64(output, records_offset);
+    
+    // The pool is only complete once every record has been written, so its
+    // header fields are filled in at the end
+    uint64_t pool_fields_pos = output.tellp();
+    writeU64(output, 0);
+    writeU64(output, 0);
+    writeU32(output, flags);
+    writeU32(output, resource_version);
+    writeU64(output, root);
+    
+    for (const std::string& type : types) {
+        writeU32(output, add_string(type));
+        writeU32(output, type.size());
+    }
+    for (uint32_t displacement : displacements) {
+        writeU32(output, displacement);
+    }
+    for (uint64_t pos = buckets_offset + displacements.size() * 4; 
+            pos < records_offset; ++pos) {
+        writeU8(output, 0);
+    }
+    for (std::size_t slot = 0; slot < records.size(); ++slot) {
+        const Index_Entry& entry = *records[slot];
+        writeU64(output, hash_name(entry.m_name));
+        writeU32(output, add_string(entry.m_name));
+        writeU32(output, entry.m_name.size());
+        writeU32(output, record_type_ids[slot]);
+        writeU32(output, (uint32_t) entry.m_codec);
+        writeU32(output, add_string(entry.m_file));
+        writeU32(output, entry.m_file.size());
+        writeU64(output, entry.m_offset);
+        writeU64(output, entry.m_size);
+        writeU64(output, entry.m_raw_size);
+        writeU64(output, entry.m_checksum);
+    }
+    output.write(pool.data(), pool.size());
+    
+    output.seekp(pool_fields_pos);
+    writeU64(output, strings_offset);
+    writeU64(output, pool.size());
+    
+    output.close();
+    if (output.fail()) {
+        std::stringstream sss;
+        sss << "Error while writing index: "
+            << file;
+        throw std::runtime_error(sss.str());
+    }
+}
+
+void read_index(const boost::filesystem::path& file, 
+        std::vector<Index_Entry>& entries) {
+    std::ifstream input(file.string().c_str(), std::ios::binary);
+    if (input.fail()) {
+        std::stringstream sss;
+        sss << "Cannot open index for reading: "
+            << file;
+        throw std::runtime_error(sss.str());
+    }
+    char magic[sizeof(n_index_magic)];
+    input.read(magic, sizeof(magic));
+    if (input.fail() || !std::equal(magic, magic + sizeof(magic), 
+            n_index_magic)) {
+        std::stringstream sss;
+        sss << "Not a resource index: "
+            << file;
+        throw std::runtime_error(sss.str());
+    }
+    uint32_t version = readU32(input);
+    if (version != n_index_version) {
+        std::stringstream sss;
+        sss << "Unsupported index version "
+            << version
+            << ": "
+            << file;
+        throw std::runtime_error(sss.str());
+    }
+    uint32_t num_entries = readU32(input);
+    readU32(input); // Buckets are only needed for lookups
+    uint32_t num_types = readU32(input);
+    uint64_t types_offset = readU64(input);
+    readU64(input);
+    uint64_t records_offset = readU64(input);
+    uint64_t strings_offset = readU64(input);
+    uint64_t strings_size = readU64(input);
+    
+    // The tables must lie within the file before anything is allocated for
+    // them, since a damaged index can claim any size
+    uint64_t index_size = boost::filesystem::file_size(file);
+    auto check_extent = [&input, &file, index_size](uint64_t offset, 
+            uint64_t count, uint64_t item_size) {
+        if (input.fail() || offset > index_size 
+                || count > (index_size - offset) / item_size) {
+            std::stringstream sss;
+            sss << "Index is truncated or corrupt: "
+                << file;
+            throw std::runtime_error(sss.str());
+        }
+    };
+    check_extent(types_offset, num_types, 8);
+    check_extent(records_offset, num_entries, n_index_record_size);
+    check_extent(strings_offset, strings_size, 1);
+    
+    std::string pool(strings_size, '\0');
+    input.seekg(strings_offset);
+    input.read(&pool[0], strings_size);
+    if (input.fail()) {
+        std::stringstream sss;
+        sss << "Error while reading index: "
+            << file;
+        throw std::runtime_error(sss.str());
+    }
+    auto get_string = [&pool, &file](uint32_t offset, uint32_t size) {
+        if (offset > pool.size() || size > pool.size() - offset) {
+            std::stringstream sss;
+            sss << "Corrupt string in index: "
+                << file;
+            throw std::runtime_error(sss.str());
+        }
+        return pool.substr(offset, size);
+    };
+    
+    std::vector<std::string> types;
+    input.seekg(types_offset);
+    for (uint32_t idx = 0; idx < num_types; ++idx) {
+        uint32_t offset = readU32(input);
+        uint32_t size = readU32(input);
+        types.push_back(get_string(offset, size));
+    }
+    
+    entries.clear();
+    entries.reserve(num_entries);
+    input.seekg(records_offset);
+    for (uint32_t idx = 0; idx < num_entries; ++idx) {
+        Index_Entry entry;
+        readU64(input);
+        uint32_t name_offset = readU32(input);
+        uint32_t name_size = readU32(input);
+        entry.m_name = get_string(name_offset, name_size);
+        uint32_t type_id = readU32(input);
+        if (type_id >= types.size()) {
+            std::stringstream sss;
+            sss << "Corrupt type in index: "
+                << file;
+            throw std::runtime_error(sss.str());
+        }
+        entry.m_type = types[type_id];
+        entry.m_codec = (Codec) readU32(input);
+        uint32_t file_offset = readU32(input);
+        uint32_t file_size = readU32(input);
+        entry.m_file = get_string(file_offset, file_size);
+        entry.m_offset = readU64(input);
+        entry.m_size = readU64(input);
+        entry.m_raw_size = readU64(input);
+        entry.m_checksum = readU64(input);
+        entries.push_back(entry);
+    }
+    if (input.fail()) {
+        std::stringstream sss;
+        sss << "Error while reading index: "
+            << file;
+        throw std::runtime_error(sss.str());
+    }
+}
+
+} // namespace resman
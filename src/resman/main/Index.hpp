@@ -0,0 +1,133 @@
+/*
+ *  Copyright 2017 James Fong
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef RESMAN_MAIN_INDEX_HPP
+#define RESMAN_MAIN_INDEX_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "Compress.hpp"
+
+namespace resman {
+
+/* Binary package index layout, meant to be mapped and used in place. All
+ * integers are little-endian.
+ * 
+ * Header, 80 bytes:
+ *     char[8] magic "RESMINDX"
+ *     u32     format version
+ *     u32     number of entries
+ *     u32     number of buckets
+ *     u32     number of types
+ *     u64     offset of the type table
+ *     u64     offset of the bucket table
+ *     u64     offset of the records
+ *     u64     offset of the string pool
+ *     u64     size of the string pool
+ *     u32     flags, see n_index_flag_*
+ *     u32     format version of the resources, the "fversion" also in
+ *             data.package, packed as major << 16 | minor << 8 | patch.
+ *             Zero if unknown.
+ *     u64     Merkle root of the entry checksums, if flagged
+ * 
+ * Type table, one 8-byte record per type. A type's id is its position.
+ *     u32     offset in the string pool
+ *     u32     size
+ * 
+ * Bucket table, one u32 displacement per bucket.
+ * 
+ * Records, 64 bytes each, starting on a multiple of 8:
+ *     u64     hash_name() of the name
+ *     u32     name offset in the string pool
+ *     u32     name size
+ *     u32     type id
+ *     u32     codec, see Codec
+ *     u32     offset in the string pool of the file holding the entry,
+ *             relative to the index
+ *     u32     size of that file name
+ *     u64     offset of the entry's bytes within that file
+ *     u64     size of the entry's bytes as stored
+ *     u64     size of the entry's bytes once decompressed
+ *     u64     checksum of the entry's bytes as stored, see checksum_data()
+ * 
+ * String pool, not null-terminated.
+ * 
+ * The buckets and records form a minimal perfect hash over the names. To
+ * find a name with hash h:
+ *     d = displacement of bucket (h % number of buckets)
+ *     record = index_slot(h, d, number of entries)
+ * and then compare the name (or just the hash) to make sure it is there.
+ * An empty index has a single bucket and no records.
+ * 
+ * The Merkle tree's leaves are the records' checksums in record order. Each
+ * level pairs up neighbours with merkle_parent(); a node left without a
+ * partner moves up unchanged. The root of an empty index is zero. Checking
+ * the root against a trusted copy shows that every checksum, and so every
+ * entry, is genuine.
+ */
+
+const uint32_t n_index_version = 2;
+const uint64_t n_index_header_size = 80;
+const uint64_t n_index_record_size = 64;
+
+const uint32_t n_index_flag_merkle_root = 1 << 0;
+
+struct Index_Entry {
+    std::string m_name;
+    std::string m_type;
+    std::string m_file;
+    uint64_t m_offset = 0;
+    uint64_t m_size = 0;
+    uint64_t m_raw_size = 0;
+    Codec m_codec = Codec::NONE;
+    uint64_t m_checksum = 0;
+};
+
+/**
+ * @brief Which record a hash lands on for a given displacement
+ */
+uint32_t index_slot(uint64_t hash, uint32_t displacement, 
+        uint32_t num_entries);
+
+/**
+ * @brief Combines two nodes of the Merkle tree
+ */
+uint64_t merkle_parent(uint64_t left, uint64_t right);
+
+/**
+ * @brief Builds the perfect hash and writes the index. Throws if two names
+ * have the same hash.
+ * @param resource_version Packed format version of the resources, see the
+ * header layout above
+ */
+void write_index(const boost::filesystem::path& file, 
+        const std::vector<Index_Entry>& entries, bool merkle_root = false,
+        uint32_t resource_version = 0);
+
+/**
+ * @brief Reads back an index written by write_index(), in record order.
+ * Throws if the file is not an index.
+ */
+void read_index(const boost::filesystem::path& file, 
+        std::vector<Index_Entry>& entries);
+
+} // namespace resman
+
+#endif // RESMAN_MAIN_INDEX_HPP
@@ -0,0 +1,316 @@
+/*
+ *  Copyright 2017 James Fong
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "Pack.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+#include "StreamWrite.hpp"
+
+namespace resman {
+
+const char n_pack_magic[8] = {'R', 'E', 'S', 'M', 'P', 'A', 'C', 'K'};
+
+// Used when copying entries into the archive
+const std::size_t n_pack_copy_chunk_size = 1 << 20;
+
+namespace {
+
+uint64_t align_up(uint64_t value) {
+    return (value + n_pack_alignment - 1) / n_pack_alignment 
+            * n_pack_alignment;
+}
+
+/**
+ * @brief Builds the string pool. Types are only stored once.
+ */
+struct String_Pool {
+    std::string m_data;
+    std::map<std::string, uint32_t> m_types;
+    
+    uint32_t add(const std::string& str) {
+        uint32_t offset = m_data.size();
+        m_data += str;
+        return offset;
+    }
+    
+    uint32_t add_type(const std::string& type) {
+        auto iter = m_types.find(type);
+        if (iter != m_types.end()) {
+            return iter->second;
+        }
+        uint32_t offset = add(type);
+        m_types[type] = offset;
+        return offset;
+    }
+};
+
+uint64_t string_pool_size(const std::vector<Pack_Entry>& entries) {
+    String_Pool pool;
+    for (const Pack_Entry& entry : entries) {
+        pool.add(entry.m_name);
+        pool.add_type(entry.m_type);
+    }
+    return pool.m_data.size();
+}
+
+void write_padding(std::ofstream& output, uint64_t size) {
+    static const char zeros[64] = {0};
+    while (size > 0) {
+        uint64_t num = size < sizeof(zeros) ? size : sizeof(zeros);
+        output.write(zeros, num);
+        size -= num;
+    }
+}
+
+} // namespace
+
+void order_pack(std::vector<Pack_Entry>& entries) {
+    std::vector<std::size_t> order(entries.size());
+    for (std::size_t idx = 0; idx < order.size(); ++idx) {
+        order[idx] = idx;
+    }
+    std::stable_sort(order.begin(), order.end(), 
+            [&entries](std::size_t a, std::size_t b)->bool {
+                return entries[a].m_load_order < entries[b].m_load_order;
+            });
+    
+    // Maps the old index of each group's original to the new index of the
+    // group's earliest member
+    std::map<int64_t, int64_t> firsts;
+    std::vector<Pack_Entry> sorted;
+    sorted.reserve(entries.size());
+    for (std::size_t old_idx : order) {
+        Pack_Entry& entry = entries[old_idx];
+        int64_t original = entry.m_same_as >= 0 
+                ? entry.m_same_as : (int64_t) old_idx;
+        auto iter = firsts.find(original);
+        if (iter == firsts.end()) {
+            firsts[original] = sorted.size();
+            entry.m_same_as = -1;
+        } else {
+            entry.m_same_as = iter->second;
+        }
+        sorted.push_back(std::move(entry));
+    }
+    entries = std::move(sorted);
+}
+
+std::vector<std::vector<Pack_Entry> > split_pack(
+        std::vector<Pack_Entry>& entries, uint64_t max_size) {
+    std::vector<std::vector<Pack_Entry> > volumes;
+    if (max_size == 0) {
+        volumes.push_back(std::move(entries));
+        return volumes;
+    }
+    
+    // Which volume each entry went into, and where
+    std::vector<std::size_t> volume_of(entries.size());
+    std::vector<int64_t> index_in_volume(entries.size());
+    
+    // Tracks an upper bound of the current volume's size as laid out by
+    // layout_pack(), which is exact apart from the last entry's padding
+    uint64_t num_records = 0;
+    uint64_t pool_size = 0;
+    std::set<std::string> types;
+    uint64_t data_size = 0;
+    
+    volumes.emplace_back();
+    for (std::size_t idx = 0; idx < entries.size(); ++idx) {
+        Pack_Entry& entry = entries[idx];
+        if (entry.m_same_as >= 0 
+                && volume_of[entry.m_same_as] != volumes.size() - 1) {
+            const Pack_Entry& original = 
+                    volumes[volume_of[entry.m_same_as]]
+                            [index_in_volume[entry.m_same_as]];
+            entry.m_file = original.m_file;
+            entry.m_codec = original.m_codec;
+            entry.m_raw_size = original.m_raw_size;
+            entry.m_same_as = -1;
+        }
+        
+        uint64_t added_pool = entry.m_name.size();
+        if (types.find(entry.m_type) == types.end()) {
+            added_pool += entry.m_type.size();
+        }
+        uint64_t added_data = entry.m_same_as >= 0 ? 0 
+                : align_up(boost::filesystem::file_size(entry.m_file));
+        uint64_t size = align_up(n_pack_header_size 
+                + (num_records + 1) * n_pack_record_size 
+                + pool_size + added_pool) + data_size + added_data;
+        if (size > max_size && num_records > 0) {
+            volumes.emplace_back();
+            num_records = 0;
+            pool_size = 0;
+            types.clear();
+            data_size = 0;
+            --idx;
+            continue;
+        }
+        
+        ++num_records;
+        pool_size += added_pool;
+        types.insert(entry.m_type);
+        data_size += added_data;
+        if (entry.m_same_as >= 0) {
+            entry.m_same_as = index_in_volume[entry.m_same_as];
+        }
+        volume_of[idx] = volumes.size() - 1;
+        index_in_volume[idx] = volumes.back().size();
+        volumes.back().push_back(std::move(entry));
+    }
+    entries.clear();
+    return volumes;
+}
+
+uint64_t layout_pack(std::vector<Pack_Entry>& entries) {
+    uint64_t position = n_pack_header_size 
+            + entries.size() * n_pack_record_size
+            + string_pool_size(entries);
+    for (Pack_Entry& entry : entries) {
+        if (entry.m_same_as >= 0) {
+            const Pack_Entry& original = entries[entry.m_same_as];
+            entry.m_file = original.m_file;
+            entry.m_codec = original.m_codec;
+            entry.m_raw_size = original.m_raw_size;
+            entry.m_offset = original.m_offset;
+            entry.m_size = original.m_size;
+            continue;
+        }
+        entry.m_size = boost::filesystem::file_size(entry.m_file);
+        if (entry.m_codec == Codec::NONE) {
+            entry.m_raw_size = entry.m_size;
+        }
+        entry.m_offset = align_up(position);
+        position = entry.m_offset + entry.m_size;
+    }
+    return position;
+}
+
+void write_pack(const boost::filesystem::path& file, 
+        const std::vector<Pack_Entry>& entries, const Hash128& build_key) {
+    std::ofstream output(file.string().c_str(), 
+            std::ios::out | std::ios::binary | std::ios::trunc);
+    if (output.fail()) {
+        std::stringstream sss;
+        sss << "Cannot open archive for writing: "
+            << file;
+        throw std::runtime_error(sss.str());
+    }
+    
+    String_Pool pool;
+    std::vector<uint32_t> name_offsets;
+    std::vector<uint32_t> type_offsets;
+    for (const Pack_Entry& entry : entries) {
+        name_offsets.push_back(pool.add(entry.m_name));
+        type_offsets.push_back(pool.add_type(entry.m_type));
+    }
+    uint64_t toc_offset = n_pack_header_size;
+    uint64_t strings_offset = 
+            toc_offset + entries.size() * n_pack_record_size;
+    
+    output.write(n_pack_magic, sizeof(n_pack_magic));
+    writeU32(output, n_pack_version);
+    writeU32(output, n_pack_alignment);
+    writeU32(output, entries.size());
+    writeU32(output, 0);
+    writeU64(output, toc_offset);
+    writeU64(output, strings_offset);
+    writeU64(output, pool.m_data.size());
+    writeU64(output, build_key.m_low);
+    writeU64(output, build_key.m_high);
+    
+    for (std::size_t idx = 0; idx < entries.size(); ++idx) {
+        const Pack_Entry& entry = entries[idx];
+        writeU32(output, name_offsets[idx]);
+        writeU32(output, entry.m_name.size());
+        writeU32(output, type_offsets[idx]);
+        writeU32(output, entry.m_type.size());
+        writeU64(output, entry.m_offset);
+        writeU64(output, entry.m_size);
+        writeU64(output, entry.m_raw_size);
+        writeU32(output, (uint32_t) entry.m_codec);
+        writeU32(output, 0);
+    }
+    output.write(pool.m_data.data(), pool.m_data.size());
+    
+    uint64_t position = strings_offset + pool.m_data.size();
+    std::vector<char> buffer(n_pack_copy_chunk_size);
+    for (const Pack_Entry& entry : entries) {
+        if (entry.m_same_as >= 0) {
+            continue;
+        }
+        write_padding(output, entry.m_offset - position);
+        
+        std::ifstream input(entry.m_file.string().c_str(), std::ios::binary);
+        uint64_t remaining = entry.m_size;
+        while (remaining > 0 && input) {
+            uint64_t num = remaining < buffer.size() ? remaining : buffer.size();
+            input.read(buffer.data(), num);
+            output.write(buffer.data(), input.gcount());
+            remaining -= input.gcount();
+        }
+        if (remaining > 0) {
+            std::stringstream sss;
+            sss << "Could not read all of "
+                << entry.m_file
+                << " into the archive";
+            throw std::runtime_error(sss.str());
+        }
+        position = entry.m_offset + entry.m_size;
+    }
+    
+    output.close();
+    if (output.fail()) {
+        std::stringstream sss;
+        sss << "Error while writing archive: "
+            << file;
+        throw std::runtime_error(sss.str());
+    }
+}
+
+bool read_pack_build_key(const boost::filesystem::path& file, 
+        Hash128& build_key) {
+    std::ifstream input(file.string().c_str(), std::ios::binary);
+    if (input.fail()) {
+        return false;
+    }
+    char magic[sizeof(n_pack_magic)];
+    input.read(magic, sizeof(magic));
+    if (!input || std::memcmp(magic, n_pack_magic, sizeof(magic)) != 0) {
+        return false;
+    }
+    if (readU32(input) != n_pack_version) {
+        return false;
+    }
+    input.seekg(48);
+    Hash128 key;
+    key.m_low = readU64(input);
+    key.m_high = readU64(input);
+    if (!input) {
+        return false;
+    }
+    build_key = key;
+    return true;
+}
+
+} // namespace resman
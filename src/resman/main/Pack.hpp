@@ -0,0 +1,132 @@
+/*
+ *  Copyright 2017 James Fong
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef RESMAN_MAIN_PACK_HPP
+#define RESMAN_MAIN_PACK_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "Compress.hpp"
+#include "Hash.hpp"
+
+namespace resman {
+
+/* Pack archive layout. All integers are little-endian.
+ * 
+ * Header, 64 bytes:
+ *     char[8] magic "RESMPACK"
+ *     u32     format version
+ *     u32     alignment of every entry's offset, in bytes
+ *     u32     number of entries
+ *     u32     reserved, zero
+ *     u64     offset of the table of contents
+ *     u64     offset of the string pool
+ *     u64     size of the string pool
+ *     u64[2]  build key, see write_pack()
+ * 
+ * Table of contents, one 48-byte record per entry:
+ *     u32     name offset in the string pool
+ *     u32     name size
+ *     u32     type offset in the string pool
+ *     u32     type size
+ *     u64     offset of the entry's bytes from the start of the file
+ *     u64     size of the entry's bytes as stored
+ *     u64     size of the entry's bytes once decompressed
+ *     u32     codec, see Codec. If none, both sizes are equal and the
+ *             entry can be used in place.
+ *     u32     reserved, zero
+ * 
+ * String pool, not null-terminated.
+ * 
+ * Entry bytes, each starting on a multiple of the alignment so that a
+ * single entry can also be mapped on its own. Several records may point at
+ * the same bytes.
+ */
+
+const uint32_t n_pack_version = 2;
+const uint32_t n_pack_alignment = 4096;
+const uint64_t n_pack_header_size = 64;
+const uint64_t n_pack_record_size = 48;
+
+struct Pack_Entry {
+    std::string m_name;
+    std::string m_type;
+    
+    // Where to copy the entry's bytes from, already compressed with m_codec
+    boost::filesystem::path m_file;
+    Codec m_codec = Codec::NONE;
+    
+    // Size before compression. Set by layout_pack() if not compressed.
+    uint64_t m_raw_size = 0;
+    
+    // Index of an earlier entry with the same bytes, or -1. Such entries
+    // point at the earlier entry's bytes instead of storing their own.
+    int64_t m_same_as = -1;
+    
+    // Entries are stored in increasing order of this, see order_pack()
+    uint64_t m_load_order = 0;
+    
+    // Set by layout_pack()
+    uint64_t m_offset = 0;
+    uint64_t m_size = 0;
+};
+
+/**
+ * @brief Sorts entries by load order, keeping the given order among equals.
+ * Duplicate entries are re-pointed so that the bytes they share are stored
+ * for whichever of them is loaded first.
+ */
+void order_pack(std::vector<Pack_Entry>& entries);
+
+/**
+ * @brief Cuts entries, already in order, into volumes that each come out no
+ * larger than max_size once laid out. An entry too large for any volume gets
+ * one to itself. Every volume stands alone: a duplicate of an entry that
+ * went into an earlier volume stores the bytes again.
+ * @param max_size Zero means no limit
+ */
+std::vector<std::vector<Pack_Entry> > split_pack(
+        std::vector<Pack_Entry>& entries, uint64_t max_size);
+
+/**
+ * @brief Decides where each entry goes in the archive, in the order given.
+ * Only depends on the entries' names, types and file sizes.
+ * @return Total size of the archive in bytes
+ */
+uint64_t layout_pack(std::vector<Pack_Entry>& entries);
+
+/**
+ * @brief Writes an archive laid out by layout_pack()
+ * @param build_key Stored in the header so that an identical archive can be
+ * recognized later without reading the entries
+ */
+void write_pack(const boost::filesystem::path& file, 
+        const std::vector<Pack_Entry>& entries, const Hash128& build_key);
+
+/**
+ * @return false if the file does not exist or is not a pack archive of the
+ * current version, leaving build_key untouched
+ */
+bool read_pack_build_key(const boost::filesystem::path& file, 
+        Hash128& build_key);
+
+} // namespace resman
+
+#endif // RESMAN_MAIN_PACK_HPP
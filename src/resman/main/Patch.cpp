@@ -0,0 +1,624 @@
+/*
+ *  Copyright 2017 James Fong
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include "Patch.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Delta.hpp"
+#include "Hash.hpp"
+#include "Index.hpp"
+#include "StreamWrite.hpp"
+
+namespace resman {
+
+const char n_patch_magic[8] = {'R', 'E', 'S', 'M', 'P', 'T', 'C', 'H'};
+
+// Smaller entries are always sent in full; a delta would barely save anything
+const uint64_t n_patch_delta_min_size = 16 << 10;
+
+// Buffer size for streaming zeros and literals
+const std::size_t n_patch_chunk_size = 1 << 20;
+
+namespace {
+
+struct Segment {
+    Patch_Segment m_kind;
+    
+    // For literals, a file in the new build. Otherwise one in the old build.
+    std::string m_file;
+    uint64_t m_offset;
+    uint64_t m_size;
+    Hash128 m_hash;
+    std::string m_delta;
+};
+
+/**
+ * @brief Lists every regular file under root, as generic paths relative to
+ * root. Partially written files are ignored, and so is the build report,
+ * which differs between any two builds and is of no use to players.
+ */
+void list_files(const boost::filesystem::path& root, 
+        const boost::filesystem::path& rel, std::set<std::string>& files) {
+    boost::filesystem::directory_iterator end_iter;
+    for (boost::filesystem::directory_iterator iter(root / rel); 
+            iter != end_iter; ++iter) {
+        boost::filesystem::path child = rel / iter->path().filename();
+        if (boost::filesystem::is_directory(iter->status())) {
+            list_files(root, child, files);
+        } else if (boost::filesystem::is_regular_file(iter->status())
+                && child.extension() != ".partial"
+                && child.generic_string() != "build.report") {
+            files.insert(child.generic_string());
+        }
+    }
+}
+
+void read_region(const boost::filesystem::path& file, uint64_t offset, 
+        uint64_t size, std::string& data) {
+    std::ifstream input(file.string().c_str(), std::ios::binary);
+    data.resize(size);
+    input.seekg(offset);
+    input.read(&data[0], size);
+    if (input.fail()) {
+        std::stringstream sss;
+        sss << "Cannot read "
+            << size
+            << " bytes at "
+            << offset
+            << " from "
+            << file;
+        throw std::runtime_error(sss.str());
+    }
+}
+
+void write_hash(std::ofstream& output, const Hash128& hash) {
+    writeU64(output, hash.m_low);
+    writeU64(output, hash.m_high);
+}
+
+Hash128 read_hash(std::ifstream& input) {
+    Hash128 hash;
+    hash.m_low = readU64(input);
+    hash.m_high = readU64(input);
+    return hash;
+}
+
+/**
+ * @brief Makes sure a size read from the patch does not go past its end,
+ * before anything is allocated for it
+ */
+void check_remaining(std::ifstream& input, uint64_t patch_size, 
+        uint64_t size) {
+    std::streamoff pos = input.tellg();
+    if (input.fail() || pos < 0 || size > patch_size - (uint64_t) pos) {
+        throw std::runtime_error("Patch is truncated");
+    }
+}
+
+/**
+ * @brief Reads a string written by writeString(), all of its bytes
+ * including any zeros
+ */
+std::string read_patch_string(std::ifstream& input, uint64_t patch_size) {
+    uint32_t size = readU32(input);
+    check_remaining(input, patch_size, size);
+    std::string value(size, '\0');
+    input.read(&value[0], value.size());
+    if (input.fail()) {
+        throw std::runtime_error("Patch is truncated");
+    }
+    return value;
+}
+
+/**
+ * @brief Paths in a patch come from outside, so make sure they cannot point
+ * out of the directory being patched
+ */
+boost::filesystem::path checked_path(const std::string& rel) {
+    boost::filesystem::path path(rel);
+    bool valid = !rel.empty() && !path.has_root_path();
+    for (const boost::filesystem::path& part : path) {
+        if (part == "..") {
+            valid = false;
+        }
+    }
+    if (!valid) {
+        std::stringstream sss;
+        sss << "Patch contains an invalid path: "
+            << rel;
+        throw std::runtime_error(sss.str());
+    }
+    return path;
+}
+
+bool is_all_zero(const std::string& data) {
+    return std::all_of(data.begin(), data.end(), 
+            [](char c)->bool { return c == 0; });
+}
+
+/**
+ * @brief A segment for bytes that belong to no entry: padding, tables of
+ * contents, or a whole file like data.package
+ */
+Segment make_gap_segment(const boost::filesystem::path& new_dir, 
+        const std::string& file, uint64_t offset, uint64_t size) {
+    Segment segment;
+    segment.m_file = file;
+    segment.m_offset = offset;
+    segment.m_size = size;
+    std::string data;
+    read_region(new_dir / file, offset, size, data);
+    segment.m_kind = is_all_zero(data) 
+            ? Patch_Segment::ZERO : Patch_Segment::LITERAL;
+    return segment;
+}
+
+/**
+ * @brief Uses a delta instead of a literal if that is meaningfully smaller
+ */
+bool try_delta(Segment& segment, const boost::filesystem::path& old_dir, 
+        const std::string& old_file, uint64_t old_offset, uint64_t old_size, 
+        const std::string& new_data) {
+    if (old_size < n_patch_delta_min_size 
+            || new_data.size() < n_patch_delta_min_size) {
+        return false;
+    }
+    std::string old_data;
+    read_region(old_dir / old_file, old_offset, old_size, old_data);
+    std::string delta = make_delta(old_data.data(), old_data.size(), 
+            new_data.data(), new_data.size());
+    if (delta.size() >= new_data.size() / 8 * 7) {
+        return false;
+    }
+    segment.m_kind = Patch_Segment::DELTA;
+    segment.m_file = old_file;
+    segment.m_offset = old_offset;
+    segment.m_size = old_size;
+    segment.m_hash = hash_data(old_data.data(), old_data.size());
+    segment.m_delta = std::move(delta);
+    return true;
+}
+
+void write_segment(std::ofstream& output, 
+        const boost::filesystem::path& new_dir, const Segment& segment) {
+    writeU8(output, (uint8_t) segment.m_kind);
+    switch (segment.m_kind) {
+        case Patch_Segment::ZERO: {
+            writeU64(output, segment.m_size);
+            break;
+        }
+        case Patch_Segment::LITERAL: {
+            writeU64(output, segment.m_size);
+            std::string data;
+            read_region(new_dir / segment.m_file, segment.m_offset, 
+                    segment.m_size, data);
+            output.write(data.data(), data.size());
+            break;
+        }
+        case Patch_Segment::COPY: {
+            writeString(output, segment.m_file);
+            writeU64(output, segment.m_offset);
+            writeU64(output, segment.m_size);
+            write_hash(output, segment.m_hash);
+            break;
+        }
+        case Patch_Segment::DELTA: {
+            writeString(output, segment.m_file);
+            writeU64(output, segment.m_offset);
+            writeU64(output, segment.m_size);
+            write_hash(output, segment.m_hash);
+            writeU64(output, segment.m_delta.size());
+            output.write(segment.m_delta.data(), segment.m_delta.size());
+            break;
+        }
+    }
+}
+
+} // namespace
+
+Patch_Stats write_patch(const boost::filesystem::path& old_dir, 
+        const boost::filesystem::path& new_dir, 
+        const boost::filesystem::path& patch_file) {
+    Patch_Stats stats;
+    
+    std::vector<Index_Entry> old_entries;
+    std::vector<Index_Entry> new_entries;
+    read_index(old_dir / "data.index", old_entries);
+    read_index(new_dir / "data.index", new_entries);
+    
+    std::string data;
+    std::map<Hash128, const Index_Entry*> old_by_content;
+    std::map<std::string, std::size_t> old_by_name;
+    std::vector<Hash128> old_hashes;
+    for (std::size_t idx = 0; idx < old_entries.size(); ++idx) {
+        const Index_Entry& entry = old_entries[idx];
+        read_region(old_dir / entry.m_file, entry.m_offset, entry.m_size, 
+                data);
+        Hash128 hash = hash_data(data.data(), data.size());
+        old_hashes.push_back(hash);
+        old_by_content.emplace(hash, &entry);
+        old_by_name[entry.m_name] = idx;
+    }
+    
+    std::vector<std::string> added;
+    std::vector<std::string> changed;
+    std::vector<std::string> deleted;
+    std::vector<Hash128> new_hashes;
+    std::set<std::string> new_names;
+    for (const Index_Entry& entry : new_entries) {
+        read_region(new_dir / entry.m_file, entry.m_offset, entry.m_size, 
+                data);
+        Hash128 hash = hash_data(data.data(), data.size());
+        new_hashes.push_back(hash);
+        new_names.insert(entry.m_name);
+        auto iter = old_by_name.find(entry.m_name);
+        if (iter == old_by_name.end()) {
+            added.push_back(entry.m_name);
+        } else if (old_hashes[iter->second] != hash) {
+            changed.push_back(entry.m_name);
+        } else {
+            ++stats.m_num_unchanged;
+        }
+    }
+    for (const Index_Entry& entry : old_entries) {
+        if (new_names.find(entry.m_name) == new_names.end()) {
+            deleted.push_back(entry.m_name);
+        }
+    }
+    std::sort(added.begin(), added.end());
+    std::sort(changed.begin(), changed.end());
+    std::sort(deleted.begin(), deleted.end());
+    stats.m_num_added = added.size();
+    stats.m_num_changed = changed.size();
+    stats.m_num_deleted = deleted.size();
+    
+    std::set<std::string> old_files;
+    std::set<std::string> new_files;
+    list_files(old_dir, "", old_files);
+    list_files(new_dir, "", new_files);
+    std::vector<std::string> deleted_files;
+    for (const std::string& file : old_files) {
+        if (new_files.find(file) == new_files.end()) {
+            deleted_files.push_back(file);
+        }
+    }
+    std::vector<std::string> written_files;
+    for (const std::string& file : new_files) {
+        if (old_files.find(file) == old_files.end()
+                || hash_file(old_dir / file) != hash_file(new_dir / file)) {
+            written_files.push_back(file);
+        }
+    }
+    stats.m_num_files_written = written_files.size();
+    stats.m_num_files_deleted = deleted_files.size();
+    
+    std::map<std::string, std::vector<std::size_t> > new_by_file;
+    for (std::size_t idx = 0; idx < new_entries.size(); ++idx) {
+        new_by_file[new_entries[idx].m_file].push_back(idx);
+    }
+    
+    std::ofstream output(patch_file.string().c_str(), 
+            std::ios::out | std::ios::binary | std::ios::trunc);
+    if (output.fail()) {
+        std::stringstream sss;
+        sss << "Cannot open patch for writing: "
+            << patch_file;
+        throw std::runtime_error(sss.str());
+    }
+    output.write(n_patch_magic, sizeof(n_patch_magic));
+    writeU32(output, n_patch_version);
+    writeU32(output, added.size());
+    writeU32(output, changed.size());
+    writeU32(output, deleted.size());
+    writeU32(output, deleted_files.size());
+    writeU32(output, written_files.size());
+    for (const std::string& name : added) {
+        writeString(output, name);
+    }
+    for (const std::string& name : changed) {
+        writeString(output, name);
+    }
+    for (const std::string& name : deleted) {
+        writeString(output, name);
+    }
+    for (const std::string& file : deleted_files) {
+        writeString(output, file);
+    }
+    
+    for (const std::string& file : written_files) {
+        boost::filesystem::path new_path = new_dir / file;
+        uint64_t file_size = boost::filesystem::file_size(new_path);
+        std::vector<Segment> segments;
+        
+        // Entries sorted by where they are in the file. Records that share
+        // bytes with an earlier one are skipped.
+        std::vector<std::size_t> in_file;
+        auto iter = new_by_file.find(file);
+        if (iter != new_by_file.end()) {
+            in_file = iter->second;
+        }
+        std::stable_sort(in_file.begin(), in_file.end(), 
+                [&new_entries](std::size_t a, std::size_t b)->bool {
+                    return new_entries[a].m_offset < new_entries[b].m_offset;
+                });
+        
+        if (in_file.empty()) {
+            Segment segment = make_gap_segment(new_dir, file, 0, file_size);
+            if (segment.m_kind == Patch_Segment::LITERAL
+                    && old_files.find(file) != old_files.end()) {
+                read_region(new_path, 0, file_size, data);
+                try_delta(segment, old_dir, file, 0, 
+                        boost::filesystem::file_size(old_dir / file), data);
+            }
+            if (file_size > 0) {
+                segments.push_back(std::move(segment));
+            }
+        }
+        
+        uint64_t cursor = 0;
+        for (std::size_t idx : in_file) {
+            const Index_Entry& entry = new_entries[idx];
+            if (entry.m_offset < cursor || entry.m_size == 0) {
+                continue;
+            }
+            if (entry.m_offset > cursor) {
+                segments.push_back(make_gap_segment(new_dir, file, cursor, 
+                        entry.m_offset - cursor));
+            }
+            cursor = entry.m_offset + entry.m_size;
+            
+            Segment segment;
+            auto same = old_by_content.find(new_hashes[idx]);
+            if (same != old_by_content.end()) {
+                segment.m_kind = Patch_Segment::COPY;
+                segment.m_file = same->second->m_file;
+                segment.m_offset = same->second->m_offset;
+                segment.m_size = same->second->m_size;
+                segment.m_hash = new_hashes[idx];
+                segments.push_back(std::move(segment));
+                continue;
+            }
+            segment.m_kind = Patch_Segment::LITERAL;
+            segment.m_file = file;
+            segment.m_offset = entry.m_offset;
+            segment.m_size = entry.m_size;
+            auto previous = old_by_name.find(entry.m_name);
+            if (previous != old_by_name.end()) {
+                const Index_Entry& old_entry = old_entries[previous->second];
+                read_region(new_path, entry.m_offset, entry.m_size, data);
+                if (try_delta(segment, old_dir, old_entry.m_file, 
+                        old_entry.m_offset, old_entry.m_size, data)) {
+                    ++stats.m_num_deltas;
+                }
+            }
+            segments.push_back(std::move(segment));
+        }
+        if (!in_file.empty() && cursor < file_size) {
+            segments.push_back(make_gap_segment(new_dir, file, cursor, 
+                    file_size - cursor));
+        }
+        
+        writeString(output, file);
+        write_hash(output, hash_file(new_path));
+        writeU32(output, segments.size());
+        for (const Segment& segment : segments) {
+            write_segment(output, new_dir, segment);
+        }
+    }
+    
+    output.close();
+    if (output.fail()) {
+        std::stringstream sss;
+        sss << "Error while writing patch: "
+            << patch_file;
+        throw std::runtime_error(sss.str());
+    }
+    stats.m_patch_size = boost::filesystem::file_size(patch_file);
+    return stats;
+}
+
+Patch_Stats apply_patch(const boost::filesystem::path& dir, 
+        const boost::filesystem::path& patch_file) {
+    Patch_Stats stats;
+    
+    std::ifstream input(patch_file.string().c_str(), std::ios::binary);
+    if (input.fail()) {
+        std::stringstream sss;
+        sss << "Cannot open patch for reading: "
+            << patch_file;
+        throw std::runtime_error(sss.str());
+    }
+    char magic[sizeof(n_patch_magic)];
+    input.read(magic, sizeof(magic));
+    if (input.fail() || !std::equal(magic, magic + sizeof(magic), 
+            n_patch_magic)) {
+        std::stringstream sss;
+        sss << "Not a resource patch: "
+            << patch_file;
+        throw std::runtime_error(sss.str());
+    }
+    uint32_t version = readU32(input);
+    if (version != n_patch_version) {
+        std::stringstream sss;
+        sss << "Unsupported patch version "
+            << version
+            << ": "
+            << patch_file;
+        throw std::runtime_error(sss.str());
+    }
+    stats.m_num_added = readU32(input);
+    stats.m_num_changed = readU32(input);
+    stats.m_num_deleted = readU32(input);
+    stats.m_num_files_deleted = readU32(input);
+    stats.m_num_files_written = readU32(input);
+    
+    // Sizes in the patch come from outside too, so they are checked against
+    // what is left of it
+    uint64_t patch_size = boost::filesystem::file_size(patch_file);
+    uint64_t num_names = (uint64_t) stats.m_num_added 
+            + stats.m_num_changed + stats.m_num_deleted;
+    for (uint64_t idx = 0; idx < num_names; ++idx) {
+        read_patch_string(input, patch_size);
+    }
+    std::vector<boost::filesystem::path> deleted_files;
+    for (uint32_t idx = 0; idx < stats.m_num_files_deleted; ++idx) {
+        deleted_files.push_back(
+                checked_path(read_patch_string(input, patch_size)));
+    }
+    
+    // Nothing in the directory is touched until every file has been
+    // rebuilt and checked
+    std::vector<boost::filesystem::path> written_files;
+    auto partial_path = [&dir](const boost::filesystem::path& file) {
+        boost::filesystem::path partial = dir / file;
+        partial += ".partial";
+        return partial;
+    };
+    try {
+        std::vector<char> buffer(n_patch_chunk_size);
+        std::string old_data;
+        std::string delta;
+        for (uint32_t file_idx = 0; file_idx < stats.m_num_files_written; 
+                ++file_idx) {
+            boost::filesystem::path file = 
+                    checked_path(read_patch_string(input, patch_size));
+            Hash128 expected = read_hash(input);
+            uint32_t num_segments = readU32(input);
+            if (input.fail()) {
+                throw std::runtime_error("Patch is truncated");
+            }
+            
+            boost::filesystem::path partial = partial_path(file);
+            boost::filesystem::create_directories(partial.parent_path());
+            written_files.push_back(file);
+            std::ofstream output(partial.string().c_str(), 
+                    std::ios::out | std::ios::binary | std::ios::trunc);
+            if (output.fail()) {
+                std::stringstream sss;
+                sss << "Cannot open file for writing: "
+                    << partial;
+                throw std::runtime_error(sss.str());
+            }
+            
+            for (uint32_t seg_idx = 0; seg_idx < num_segments; ++seg_idx) {
+                Patch_Segment kind = (Patch_Segment) readU8(input);
+                if (kind == Patch_Segment::ZERO 
+                        || kind == Patch_Segment::LITERAL) {
+                    uint64_t size = readU64(input);
+                    bool zero = kind == Patch_Segment::ZERO;
+                    if (zero) {
+                        std::fill(buffer.begin(), buffer.end(), 0);
+                    }
+                    while (size > 0 && !input.fail()) {
+                        std::size_t chunk = std::min<uint64_t>(
+                                size, buffer.size());
+                        if (!zero) {
+                            input.read(buffer.data(), chunk);
+                        }
+                        output.write(buffer.data(), chunk);
+                        size -= chunk;
+                    }
+                } else if (kind == Patch_Segment::COPY 
+                        || kind == Patch_Segment::DELTA) {
+                    boost::filesystem::path old_file = checked_path(
+                            read_patch_string(input, patch_size));
+                    uint64_t offset = readU64(input);
+                    uint64_t size = readU64(input);
+                    Hash128 hash = read_hash(input);
+                    if (input.fail()) {
+                        throw std::runtime_error("Patch is truncated");
+                    }
+                    boost::system::error_code error;
+                    uint64_t old_size = 
+                            boost::filesystem::file_size(dir / old_file, error);
+                    if (error || offset > old_size 
+                            || size > old_size - offset) {
+                        std::stringstream sss;
+                        sss << "Patch does not match this directory, "
+                            << old_file
+                            << " is missing or too small";
+                        throw std::runtime_error(sss.str());
+                    }
+                    read_region(dir / old_file, offset, size, old_data);
+                    if (hash_data(old_data.data(), old_data.size()) != hash) {
+                        std::stringstream sss;
+                        sss << "Patch does not match this directory, "
+                            << old_file
+                            << " differs";
+                        throw std::runtime_error(sss.str());
+                    }
+                    if (kind == Patch_Segment::COPY) {
+                        output.write(old_data.data(), old_data.size());
+                        continue;
+                    }
+                    uint64_t delta_size = readU64(input);
+                    check_remaining(input, patch_size, delta_size);
+                    delta.resize(delta_size);
+                    input.read(&delta[0], delta_size);
+                    if (input.fail()) {
+                        throw std::runtime_error("Patch is truncated");
+                    }
+                    std::string new_data = apply_delta(old_data.data(), 
+                            old_data.size(), delta.data(), delta.size());
+                    output.write(new_data.data(), new_data.size());
+                } else {
+                    throw std::runtime_error("Patch is corrupt");
+                }
+            }
+            if (input.fail()) {
+                throw std::runtime_error("Patch is truncated");
+            }
+            output.close();
+            if (output.fail()) {
+                std::stringstream sss;
+                sss << "Error while writing file: "
+                    << partial;
+                throw std::runtime_error(sss.str());
+            }
+            if (hash_file(partial) != expected) {
+                std::stringstream sss;
+                sss << "Patched file has the wrong contents: "
+                    << file;
+                throw std::runtime_error(sss.str());
+            }
+        }
+    } catch (...) {
+        for (const boost::filesystem::path& file : written_files) {
+            boost::system::error_code error;
+            boost::filesystem::remove(partial_path(file), error);
+        }
+        throw;
+    }
+    
+    for (const boost::filesystem::path& file : written_files) {
+        boost::filesystem::rename(partial_path(file), dir / file);
+    }
+    for (const boost::filesystem::path& file : deleted_files) {
+        boost::filesystem::remove(dir / file);
+    }
+    return stats;
+}
+
+} // namespace resman
@@ -0,0 +1,108 @@
+/*
+ *  Copyright 2017 James Fong
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#ifndef RESMAN_MAIN_PATCH_HPP
+#define RESMAN_MAIN_PATCH_HPP
+
+#include <cstdint>
+
+#include <boost/filesystem.hpp>
+
+namespace resman {
+
+/* Patch layout. Turns one output directory into a later one. All integers
+ * are little-endian, strings are a u32 size followed by the bytes.
+ * 
+ * Header:
+ *     char[8] magic "RESMPTCH"
+ *     u32     format version
+ *     u32     number of added entries
+ *     u32     number of changed entries
+ *     u32     number of deleted entries
+ *     u32     number of deleted files
+ *     u32     number of files to write
+ * 
+ * Names of the added, changed and deleted entries, one string each. These
+ * are informational, e.g. for invalidating caches after an update.
+ * 
+ * Paths of the deleted files, relative to the output directory.
+ * 
+ * Files to write, each:
+ *     string  path relative to the output directory
+ *     u64[2]  hash_file() of the result
+ *     u32     number of segments
+ * followed by the segments, which are concatenated to make the file:
+ *     u8      kind, see Patch_Segment
+ *     ...
+ * 
+ * Zero:     u64 size
+ * Literal:  u64 size, then the bytes
+ * Copy:     string old file, u64 offset, u64 size, u64[2] hash_data() of
+ *           the old bytes
+ * Delta:    string old file, u64 offset, u64 size, u64[2] hash_data() of
+ *           the old bytes, u64 delta size, then a delta (see make_delta())
+ *           against the old bytes
+ * 
+ * Files which are identical in both builds are not mentioned at all, and
+ * neither is build.report.
+ */
+
+const uint32_t n_patch_version = 1;
+
+enum class Patch_Segment : uint8_t {
+    ZERO = 0,
+    LITERAL = 1,
+    COPY = 2,
+    DELTA = 3
+};
+
+struct Patch_Stats {
+    uint32_t m_num_added = 0;
+    uint32_t m_num_changed = 0;
+    uint32_t m_num_unchanged = 0;
+    uint32_t m_num_deleted = 0;
+    
+    // Changed entries sent as a delta instead of in full
+    uint32_t m_num_deltas = 0;
+    
+    uint32_t m_num_files_written = 0;
+    uint32_t m_num_files_deleted = 0;
+    uint64_t m_patch_size = 0;
+};
+
+/**
+ * @brief Compares the indices of two output directories and writes a patch
+ * holding only what is needed to turn the old one into the new one.
+ * Entries are matched by the hash of their stored bytes, so unchanged
+ * entries are copied from the old build even if they moved or were renamed.
+ * Large changed entries are sent as a delta against their old bytes.
+ */
+Patch_Stats write_patch(const boost::filesystem::path& old_dir, 
+        const boost::filesystem::path& new_dir, 
+        const boost::filesystem::path& patch_file);
+
+/**
+ * @brief Updates an output directory in place. Every file is rebuilt next to
+ * its destination and checked before anything is replaced, so a patch that
+ * does not match the directory leaves it untouched.
+ */
+Patch_Stats apply_patch(const boost::filesystem::path& dir, 
+        const boost::filesystem::path& patch_file);
+
+} // namespace resman
+
+#endif // RESMAN_MAIN_PATCH_HPP
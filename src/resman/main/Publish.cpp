@@ -0,0 +1,83 @@
+/*
+ *  Copyright 2017 James Fong
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "Publish.hpp"
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <linux/fs.h>
+#endif
+
+namespace resman {
+
+bool try_reflink(const boost::filesystem::path& from, 
+        const boost::filesystem::path& to) {
+#if defined(__linux__) && defined(FICLONE)
+    int src_fd = ::open(from.string().c_str(), O_RDONLY);
+    if (src_fd < 0) {
+        return false;
+    }
+    int dest_fd = ::open(to.string().c_str(), 
+            O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (dest_fd < 0) {
+        ::close(src_fd);
+        return false;
+    }
+    bool success = ::ioctl(dest_fd, FICLONE, src_fd) == 0;
+    ::close(dest_fd);
+    ::close(src_fd);
+    if (!success) {
+        ::unlink(to.string().c_str());
+    }
+    return success;
+#else
+    return false;
+#endif
+}
+
+Publish_Method publish_file(const boost::filesystem::path& from, 
+        const boost::filesystem::path& to, uint64_t& size, 
+        bool same_content) {
+    size = boost::filesystem::file_size(from);
+    std::time_t mtime = boost::filesystem::last_write_time(from);
+    
+    boost::system::error_code error;
+    if (boost::filesystem::exists(to)) {
+        if (same_content || boost::filesystem::equivalent(from, to, error)) {
+            return Publish_Method::UNCHANGED;
+        }
+        boost::filesystem::remove(to);
+    }
+    
+    // Copies get the same modification time as the original
+    if (try_reflink(from, to)) {
+        boost::filesystem::last_write_time(to, mtime);
+        return Publish_Method::REFLINK;
+    }
+    
+    boost::filesystem::create_hard_link(from, to, error);
+    if (!error) {
+        return Publish_Method::HARDLINK;
+    }
+    
+    boost::filesystem::copy_file(from, to);
+    boost::filesystem::last_write_time(to, mtime);
+    return Publish_Method::COPY;
+}
+
+} // namespace resman
@@ -0,0 +1,54 @@
+/*
+ *  Copyright 2017 James Fong
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef RESMAN_MAIN_PUBLISH_HPP
+#define RESMAN_MAIN_PUBLISH_HPP
+
+#include <cstdint>
+
+#include <boost/filesystem.hpp>
+
+namespace resman {
+
+enum class Publish_Method {
+    UNCHANGED,
+    REFLINK,
+    HARDLINK,
+    COPY
+};
+
+/**
+ * @brief Makes the file at "to" have the same contents as "from", as cheaply
+ * as the filesystem allows: a reflink (copy-on-write clone), then a hard
+ * link, then a full copy. Nothing is done if "to" already is "from", or is
+ * known to have the same contents.
+ * 
+ * "from" must not be modified afterwards, since the two may share storage.
+ * Cached conversions are never modified in place, so this holds for them.
+ * 
+ * @param size Set to the size of the published file
+ * @param same_content Whether "to" is known to have the same contents as
+ * "from", such as from a matching content hash. Size and modification time
+ * alone are not enough, since a file can change within the same second.
+ * @return How the file was published
+ */
+Publish_Method publish_file(const boost::filesystem::path& from, 
+        const boost::filesystem::path& to, uint64_t& size, 
+        bool same_content = false);
+
+} // namespace resman
+
+#endif // RESMAN_MAIN_PUBLISH_HPP
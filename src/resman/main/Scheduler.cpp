@@ -0,0 +1,186 @@
+/*
+ *  Copyright 2017 James Fong
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "Scheduler.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "Trace.hpp"
+
+namespace resman {
+
+Scheduler::Scheduler(uint32_t num_workers, uint64_t memory_budget)
+: m_num_workers(num_workers)
+, m_memory_budget(memory_budget) {
+    if (m_num_workers == 0) {
+        m_num_workers = std::thread::hardware_concurrency();
+    }
+    if (m_num_workers == 0) {
+        m_num_workers = 1;
+    }
+}
+
+void Scheduler::add_job(Job_Func func, uint64_t cost, uint64_t memory) {
+    m_jobs.push_back({std::move(func), cost, memory});
+}
+
+uint32_t Scheduler::get_num_workers() const {
+    return m_num_workers;
+}
+
+namespace {
+
+struct Work_Queue {
+    std::mutex m_mutex;
+    std::deque<std::size_t> m_jobs;
+};
+
+} // namespace
+
+void Scheduler::run() {
+    std::size_t num_threads = std::min<std::size_t>(
+            m_num_workers, m_jobs.size());
+
+    // Keep single-threaded runs exactly equivalent to the old serial loop
+    if (num_threads <= 1) {
+        for (Job& job : m_jobs) {
+            job.m_func();
+        }
+        m_jobs.clear();
+        return;
+    }
+
+    // Most expensive first. Ties keep insertion order so that runs are
+    // reproducible.
+    std::vector<std::size_t> order(m_jobs.size());
+    for (std::size_t idx = 0; idx < order.size(); ++idx) {
+        order[idx] = idx;
+    }
+    std::stable_sort(order.begin(), order.end(), 
+            [this](std::size_t a, std::size_t b)->bool {
+                return m_jobs[a].m_cost > m_jobs[b].m_cost;
+            });
+
+    // Deal round-robin so that every worker starts on one of the largest jobs
+    std::vector<Work_Queue> queues(num_threads);
+    for (std::size_t idx = 0; idx < order.size(); ++idx) {
+        queues[idx % num_threads].m_jobs.push_back(order[idx]);
+    }
+
+    auto pop_own = [&queues](std::size_t worker, std::size_t& job_idx) {
+        Work_Queue& queue = queues[worker];
+        std::lock_guard<std::mutex> lock(queue.m_mutex);
+        if (queue.m_jobs.empty()) {
+            return false;
+        }
+        job_idx = queue.m_jobs.front();
+        queue.m_jobs.pop_front();
+        return true;
+    };
+
+    // Take the most expensive job still waiting in any other queue. Queues
+    // are only ever drained during a run, so finding nothing means done.
+    auto steal = [this, &queues](std::size_t thief, std::size_t& job_idx) {
+        while (true) {
+            std::size_t victim = queues.size();
+            uint64_t victim_cost = 0;
+            for (std::size_t other = 0; other < queues.size(); ++other) {
+                if (other == thief) {
+                    continue;
+                }
+                Work_Queue& queue = queues[other];
+                std::lock_guard<std::mutex> lock(queue.m_mutex);
+                if (queue.m_jobs.empty()) {
+                    continue;
+                }
+                uint64_t cost = m_jobs[queue.m_jobs.front()].m_cost;
+                if (victim == queues.size() || cost > victim_cost) {
+                    victim = other;
+                    victim_cost = cost;
+                }
+            }
+            if (victim == queues.size()) {
+                return false;
+            }
+            Work_Queue& queue = queues[victim];
+            std::lock_guard<std::mutex> lock(queue.m_mutex);
+            
+            // Someone else may have emptied it in the meantime
+            if (queue.m_jobs.empty()) {
+                continue;
+            }
+            job_idx = queue.m_jobs.front();
+            queue.m_jobs.pop_front();
+            return true;
+        }
+    };
+
+    std::mutex memory_mutex;
+    std::condition_variable memory_freed;
+    uint64_t memory_in_use = 0;
+    
+    auto acquire_memory = [this, &memory_mutex, &memory_freed, 
+            &memory_in_use](uint64_t memory) {
+        if (m_memory_budget == 0) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(memory_mutex);
+        memory_freed.wait(lock, [&]()->bool {
+            return memory_in_use == 0 
+                    || memory_in_use + memory <= m_memory_budget;
+        });
+        memory_in_use += memory;
+    };
+    auto release_memory = [this, &memory_mutex, &memory_freed, 
+            &memory_in_use](uint64_t memory) {
+        if (m_memory_budget == 0) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(memory_mutex);
+            memory_in_use -= memory;
+        }
+        memory_freed.notify_all();
+    };
+
+    auto worker = [this, &pop_own, &steal, &acquire_memory, &release_memory]
+            (std::size_t worker_idx) {
+        trace_set_worker(worker_idx);
+        std::size_t job_idx;
+        while (pop_own(worker_idx, job_idx) || steal(worker_idx, job_idx)) {
+            Job& job = m_jobs[job_idx];
+            acquire_memory(job.m_memory);
+            job.m_func();
+            release_memory(job.m_memory);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads);
+    for (std::size_t i = 0; i < num_threads; ++i) {
+        threads.emplace_back(worker, i);
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    m_jobs.clear();
+}
+
+} // namespace resman
@@ -0,0 +1,83 @@
+/*
+ *  Copyright 2017 James Fong
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef RESMAN_MAIN_SCHEDULER_HPP
+#define RESMAN_MAIN_SCHEDULER_HPP
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace resman {
+
+typedef std::function<void()> Job_Func;
+
+/**
+ * @class Scheduler
+ * @brief Runs a batch of independent jobs on a pool of worker threads.
+ * Jobs must not throw; any errors should be recorded by the job itself and
+ * inspected by the caller after run() returns.
+ * 
+ * Jobs are started most-expensive first: they are sorted by estimated cost
+ * and dealt out to per-worker queues. A worker whose queue runs dry steals
+ * the most expensive job left in any other queue, so one huge job near the
+ * end of the list does not leave every other core idle.
+ * 
+ * If a memory budget is given, a job is held back until the estimated memory
+ * of all running jobs plus its own fits in the budget. A job that would not
+ * fit even on its own is run once nothing else is running.
+ */
+class Scheduler {
+public:
+    /**
+     * @param num_workers Maximum number of threads to use. Zero means one
+     * thread per hardware core. One means all jobs are run in-order on the
+     * calling thread.
+     * @param memory_budget Maximum total estimated memory in bytes of all
+     * jobs running at once. Zero means no limit.
+     */
+    Scheduler(uint32_t num_workers, uint64_t memory_budget = 0);
+
+    /**
+     * @param cost Estimated cost of the job, in any unit as long as it is
+     * consistent among all jobs in the batch
+     * @param memory Estimated peak memory use of the job in bytes
+     */
+    void add_job(Job_Func func, uint64_t cost = 0, uint64_t memory = 0);
+
+    /**
+     * @brief Blocks until every added job has finished, then clears the
+     * job list.
+     */
+    void run();
+
+    uint32_t get_num_workers() const;
+
+private:
+    struct Job {
+        Job_Func m_func;
+        uint64_t m_cost;
+        uint64_t m_memory;
+    };
+    
+    uint32_t m_num_workers;
+    uint64_t m_memory_budget;
+    std::vector<Job> m_jobs;
+};
+
+} // namespace resman
+
+#endif // RESMAN_MAIN_SCHEDULER_HPP
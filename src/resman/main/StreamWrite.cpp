@@ -87,7 +87,7 @@ void readU64(std::ifstream& input, uint64_t& value) {
     uint8_t in[8];
     input.read(reinterpret_cast<char*>(in), 8);
     value = 
-        ((uint64_t) (in[0] | in[1] << 8 | in[2] << 16 | in[3] << 24)) |
+        ((uint64_t) (uint32_t) (in[0] | in[1] << 8 | in[2] << 16 | in[3] << 24)) |
         ((uint64_t) in[4]) << 32 | 
         ((uint64_t) in[5]) << 40 | 
         ((uint64_t) in[6]) << 48 | 
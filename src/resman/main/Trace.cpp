@@ -0,0 +1,172 @@
+/*
+ *  Copyright 2017 James Fong
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "Trace.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <sstream>
+
+#include <json/json.h>
+
+#include "JsonUtil.hpp"
+
+namespace resman {
+
+namespace {
+
+struct Trace_Event {
+    const char* m_category;
+    std::string m_name;
+    uint32_t m_thread;
+    double m_start_us;
+    double m_duration_us;
+    std::vector<std::pair<std::string, std::string> > m_args;
+};
+
+std::atomic<bool> n_trace_enabled(false);
+std::chrono::steady_clock::time_point n_trace_epoch;
+
+// Guards everything below
+std::mutex n_trace_mutex;
+std::vector<Trace_Event> n_trace_events;
+
+// Trace viewers expect small integer thread ids. The main thread is 0 and
+// worker slot N of a pool is N + 1.
+std::set<uint32_t> n_trace_threads;
+
+thread_local uint32_t n_trace_thread = 0;
+
+double micros_since_epoch(std::chrono::steady_clock::time_point when) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            when - n_trace_epoch).count() / 1000.0;
+}
+
+} // namespace
+
+void trace_enable() {
+    std::lock_guard<std::mutex> lock(n_trace_mutex);
+    if (n_trace_enabled) {
+        return;
+    }
+    n_trace_epoch = std::chrono::steady_clock::now();
+    n_trace_threads.insert(0);
+    n_trace_enabled = true;
+}
+
+bool trace_is_enabled() {
+    return n_trace_enabled;
+}
+
+void trace_reset() {
+    std::lock_guard<std::mutex> lock(n_trace_mutex);
+    n_trace_epoch = std::chrono::steady_clock::now();
+    n_trace_events.clear();
+    n_trace_threads.clear();
+    n_trace_threads.insert(0);
+}
+
+void trace_set_worker(uint32_t slot) {
+    n_trace_thread = slot + 1;
+}
+
+void trace_write(const boost::filesystem::path& file) {
+    Json::Value json_trace;
+    Json::Value& json_events = json_trace["traceEvents"];
+    json_events = Json::Value(Json::arrayValue);
+    
+    std::lock_guard<std::mutex> lock(n_trace_mutex);
+    for (uint32_t thread : n_trace_threads) {
+        Json::Value json_meta;
+        json_meta["ph"] = "M";
+        json_meta["name"] = "thread_name";
+        json_meta["pid"] = 0;
+        json_meta["tid"] = thread;
+        if (thread == 0) {
+            json_meta["args"]["name"] = "main";
+        } else {
+            std::stringstream sss;
+            sss << "worker " << (thread - 1);
+            json_meta["args"]["name"] = sss.str();
+        }
+        json_events.append(json_meta);
+    }
+    for (const Trace_Event& event : n_trace_events) {
+        Json::Value json_event;
+        json_event["ph"] = "X";
+        json_event["cat"] = event.m_category;
+        json_event["name"] = event.m_name;
+        json_event["pid"] = 0;
+        json_event["tid"] = event.m_thread;
+        json_event["ts"] = event.m_start_us;
+        json_event["dur"] = event.m_duration_us;
+        if (!event.m_args.empty()) {
+            Json::Value& json_args = json_event["args"];
+            for (auto& arg : event.m_args) {
+                json_args[arg.first] = arg.second;
+            }
+        }
+        json_events.append(json_event);
+    }
+    json_trace["displayTimeUnit"] = "ms";
+    writeJsonFile(file.string(), json_trace, true);
+}
+
+Trace_Span::Trace_Span(const char* category, const std::string& name)
+: m_enabled(n_trace_enabled)
+, m_category(category) {
+    if (m_enabled) {
+        m_name = name;
+        m_start = std::chrono::steady_clock::now();
+    }
+}
+
+Trace_Span::~Trace_Span() {
+    if (!m_enabled) {
+        return;
+    }
+    auto end = std::chrono::steady_clock::now();
+    
+    Trace_Event event;
+    event.m_category = m_category;
+    event.m_name = std::move(m_name);
+    event.m_start_us = micros_since_epoch(m_start);
+    event.m_duration_us = micros_since_epoch(end) - event.m_start_us;
+    event.m_args = std::move(m_args);
+    
+    event.m_thread = n_trace_thread;
+    
+    std::lock_guard<std::mutex> lock(n_trace_mutex);
+    n_trace_threads.insert(event.m_thread);
+    n_trace_events.push_back(std::move(event));
+}
+
+void Trace_Span::add_arg(const std::string& key, const std::string& value) {
+    if (m_enabled) {
+        m_args.emplace_back(key, value);
+    }
+}
+
+void Trace_Span::add_arg(const std::string& key, uint64_t value) {
+    if (m_enabled) {
+        std::stringstream sss;
+        sss << value;
+        m_args.emplace_back(key, sss.str());
+    }
+}
+
+} // namespace resman
@@ -0,0 +1,86 @@
+/*
+ *  Copyright 2017 James Fong
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef RESMAN_MAIN_TRACE_HPP
+#define RESMAN_MAIN_TRACE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+namespace resman {
+
+/**
+ * @brief Starts recording spans. Until this is called, Trace_Span does
+ * nothing. The calling thread is labelled as the main thread.
+ */
+void trace_enable();
+
+bool trace_is_enabled();
+
+/**
+ * @brief Forgets every span recorded so far, so that the next trace_write()
+ * only covers what happens from now on. Watch mode calls this before every
+ * rebuild.
+ */
+void trace_reset();
+
+/**
+ * @brief Labels the calling thread as the given worker slot of a thread
+ * pool. Pools started one after another reuse the same rows in the viewer.
+ */
+void trace_set_worker(uint32_t slot);
+
+/**
+ * @brief Writes every span recorded so far in the Chrome trace-event format,
+ * which can be opened by chrome://tracing or the Perfetto UI
+ */
+void trace_write(const boost::filesystem::path& file);
+
+/**
+ * @class Trace_Span
+ * @brief Records the time between its construction and destruction as one
+ * span on the current thread. Spans on the same thread must nest.
+ */
+class Trace_Span {
+public:
+    Trace_Span(const char* category, const std::string& name);
+    ~Trace_Span();
+    
+    Trace_Span(const Trace_Span&) = delete;
+    Trace_Span& operator=(const Trace_Span&) = delete;
+    
+    /**
+     * @brief Attaches a value shown alongside the span in the viewer
+     */
+    void add_arg(const std::string& key, const std::string& value);
+    void add_arg(const std::string& key, uint64_t value);
+    
+private:
+    bool m_enabled;
+    const char* m_category;
+    std::string m_name;
+    std::chrono::steady_clock::time_point m_start;
+    std::vector<std::pair<std::string, std::string> > m_args;
+};
+
+} // namespace resman
+
+#endif // RESMAN_MAIN_TRACE_HPP
@@ -0,0 +1,220 @@
+/*
+ *  Copyright 2017 James Fong
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "Watcher.hpp"
+
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace resman {
+
+#if defined(__linux__)
+
+const uint32_t n_watch_mask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE 
+        | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+
+Watcher::Watcher() {
+    m_fd = inotify_init1(IN_CLOEXEC);
+    if (m_fd < 0) {
+        throw std::runtime_error("Could not initialize inotify");
+    }
+}
+
+Watcher::~Watcher() {
+    ::close(m_fd);
+}
+
+bool Watcher::is_ignored(const boost::filesystem::path& dir) {
+    for (const boost::filesystem::path& ignored_dir : m_ignores) {
+        boost::system::error_code error;
+        if (boost::filesystem::equivalent(dir, ignored_dir, error)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Watcher::is_ignored_file(const boost::filesystem::path& file) {
+    // Compared by directory, since the file itself may be gone already
+    for (const boost::filesystem::path& ignored_file : m_ignored_files) {
+        boost::system::error_code error;
+        if (file.filename() == ignored_file.filename()
+                && boost::filesystem::equivalent(file.parent_path(), 
+                        ignored_file.parent_path(), error)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Watcher::watch_dir(const boost::filesystem::path& dir) {
+    if (is_ignored(dir)) {
+        return;
+    }
+    int wd = inotify_add_watch(m_fd, dir.string().c_str(), n_watch_mask);
+    
+    // Removed again before it could be watched, which is reported as a
+    // change of its own
+    if (wd < 0 && (errno == ENOENT || errno == ENOTDIR)) {
+        return;
+    }
+    if (wd < 0) {
+        std::stringstream sss;
+        sss << "Could not watch directory: "
+            << dir;
+        throw std::runtime_error(sss.str());
+    }
+    m_watches[wd] = dir;
+    
+    boost::system::error_code error;
+    boost::filesystem::directory_iterator iter_end;
+    for (boost::filesystem::directory_iterator iter(dir, error); 
+            !error && iter != iter_end; iter.increment(error)) {
+        boost::system::error_code dir_error;
+        if (boost::filesystem::is_directory(iter->path(), dir_error)) {
+            watch_dir(iter->path());
+        }
+    }
+}
+
+void Watcher::watch_tree(const boost::filesystem::path& root, 
+        const std::vector<boost::filesystem::path>& ignores) {
+    m_ignores.insert(m_ignores.end(), ignores.begin(), ignores.end());
+    m_roots.push_back(root);
+    watch_dir(root);
+}
+
+void Watcher::ignore_file(const boost::filesystem::path& file) {
+    m_ignored_files.push_back(boost::filesystem::absolute(file));
+}
+
+std::vector<boost::filesystem::path> Watcher::wait_for_changes(
+        uint32_t settle_ms, bool& missed) {
+    std::set<boost::filesystem::path> changes;
+    missed = false;
+    
+    alignas(struct inotify_event) char buffer[16384];
+    int timeout = -1;
+    while (true) {
+        struct pollfd poll_fd;
+        poll_fd.fd = m_fd;
+        poll_fd.events = POLLIN;
+        int num_ready = ::poll(&poll_fd, 1, timeout);
+        if (num_ready == 0) {
+            break;
+        }
+        if (num_ready < 0) {
+            continue;
+        }
+        
+        ssize_t num_read = ::read(m_fd, buffer, sizeof(buffer));
+        if (num_read <= 0) {
+            continue;
+        }
+        for (char* iter = buffer; iter < buffer + num_read; ) {
+            const struct inotify_event* event = 
+                    reinterpret_cast<const struct inotify_event*>(iter);
+            iter += sizeof(struct inotify_event) + event->len;
+            
+            if (event->mask & IN_IGNORED) {
+                m_watches.erase(event->wd);
+                continue;
+            }
+            
+            // Events were dropped, including possibly the creation of
+            // directories, so those are looked for again
+            if (event->mask & IN_Q_OVERFLOW) {
+                missed = true;
+                for (const boost::filesystem::path& root : m_roots) {
+                    try {
+                        watch_dir(root);
+                    } catch (std::runtime_error& e) {
+                        // Already reported as missed
+                    }
+                }
+                continue;
+            }
+            auto watch_iter = m_watches.find(event->wd);
+            if (watch_iter == m_watches.end() || event->len == 0) {
+                continue;
+            }
+            boost::filesystem::path changed = watch_iter->second / event->name;
+            if (is_ignored_file(changed)) {
+                continue;
+            }
+            
+            if ((event->mask & IN_ISDIR) 
+                    && (event->mask & (IN_CREATE | IN_MOVED_TO))) {
+                try {
+                    watch_dir(changed);
+                } catch (std::runtime_error& e) {
+                    missed = true;
+                }
+            }
+            changes.insert(changed);
+        }
+        
+        // Keep blocking if everything so far was ignored
+        if (!changes.empty() || missed) {
+            timeout = settle_ms;
+        }
+    }
+    
+    return std::vector<boost::filesystem::path>(changes.begin(), 
+            changes.end());
+}
+
+#else
+
+Watcher::Watcher()
+: m_fd(-1) {
+    throw std::runtime_error("Watch mode is only supported on Linux");
+}
+
+Watcher::~Watcher() { }
+
+bool Watcher::is_ignored(const boost::filesystem::path& dir) {
+    return false;
+}
+
+void Watcher::watch_dir(const boost::filesystem::path& dir) { }
+
+bool Watcher::is_ignored_file(const boost::filesystem::path& file) {
+    return false;
+}
+
+void Watcher::watch_tree(const boost::filesystem::path& root, 
+        const std::vector<boost::filesystem::path>& ignores) { }
+
+void Watcher::ignore_file(const boost::filesystem::path& file) { }
+
+std::vector<boost::filesystem::path> Watcher::wait_for_changes(
+        uint32_t settle_ms, bool& missed) {
+    missed = false;
+    return std::vector<boost::filesystem::path>();
+}
+
+#endif
+
+} // namespace resman
@@ -0,0 +1,81 @@
+/*
+ *  Copyright 2017 James Fong
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef RESMAN_MAIN_WATCHER_HPP
+#define RESMAN_MAIN_WATCHER_HPP
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+namespace resman {
+
+/**
+ * @class Watcher
+ * @brief Reports files created, modified, moved or deleted anywhere in a
+ * directory tree. Only implemented with inotify (Linux); elsewhere the
+ * constructor throws.
+ */
+class Watcher {
+public:
+    Watcher();
+    ~Watcher();
+    
+    Watcher(const Watcher&) = delete;
+    Watcher& operator=(const Watcher&) = delete;
+    
+    /**
+     * @brief Watches root and every directory below it, except for those in
+     * the ignore list. Directories created later are watched automatically.
+     */
+    void watch_tree(const boost::filesystem::path& root, 
+            const std::vector<boost::filesystem::path>& ignores);
+    
+    /**
+     * @brief Never reports changes to this file, such as one written by
+     * the build itself. It does not need to exist yet.
+     */
+    void ignore_file(const boost::filesystem::path& file);
+    
+    /**
+     * @brief Blocks until something changes, then keeps collecting changes
+     * until none have arrived for settle_ms milliseconds. Editors often 
+     * write a file in several steps, which this folds into one batch.
+     * @param missed Set if some changes could not be seen, because the
+     * kernel's event queue overflowed or a new directory could not be
+     * watched. Anything may have changed then.
+     * @return Every path that changed, each listed once
+     */
+    std::vector<boost::filesystem::path> wait_for_changes(uint32_t settle_ms, 
+            bool& missed);
+
+private:
+    void watch_dir(const boost::filesystem::path& dir);
+    bool is_ignored(const boost::filesystem::path& dir);
+    bool is_ignored_file(const boost::filesystem::path& file);
+    
+    int m_fd;
+    std::vector<boost::filesystem::path> m_roots;
+    std::map<int, boost::filesystem::path> m_watches;
+    std::vector<boost::filesystem::path> m_ignores;
+    std::vector<boost::filesystem::path> m_ignored_files;
+};
+
+} // namespace resman
+
+#endif // RESMAN_MAIN_WATCHER_HPP